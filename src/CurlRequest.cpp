@@ -14,6 +14,11 @@ CurlRequest::CurlRequest(std::string url)
     curl_easy_perform(curl);
 }
 
+CurlRequest::~CurlRequest()
+{
+    curl_easy_cleanup(curl);
+}
+
 int CurlRequest::curlWrite(char* data, size_t size, size_t nmemb, std::string* buffer)
 {
     int result = 0;
@@ -3,17 +3,20 @@
 
 #include <string>
 
+#include "System/NoCopy.h"
+
 // CURL is a c lib, so this is the 'forward declaration'
 typedef void CURL;
 
-class CurlRequest
+class CurlRequest : NoCopy
 {
 public:
     /** The Curl Request object is a single call to an URL.
      *  If you want to make multiple calls, the object should be recreated.
-     *  Overhead wise this is not the best way to do it, but it shouldn't be that much slower.
+     *  For repeated calls to the same URL (like grabbing camera frames) use the FrameGrabber instead, which keeps the connection open.
      */
     CurlRequest(std::string url);
+    ~CurlRequest();
 
     /** Function required for the libcurl to write data to the buffer
      */
@@ -7,6 +7,7 @@ extern "C" {
 }
 
 #include "DBus.h"
+#include "System/EventLoop.h"
 
 namespace DBus
 {
@@ -23,6 +24,7 @@ Bus* Bus::getInstance()
 }
 
 Bus::Bus()
+: loop(nullptr), update_timer(-1)
 {
     DBusError error;
     
@@ -73,6 +75,117 @@ void Bus::update()
     }
 }
 
+bool Bus::isConnected() const
+{
+    return connection != nullptr;
+}
+
+void Bus::attach(EventLoop& loop)
+{
+    if (!connection)
+    {
+        return;
+    }
+    this->loop = &loop;
+    dbus_connection_set_watch_functions(connection, &Bus::addWatch, &Bus::removeWatch, &Bus::toggleWatch, this, nullptr);
+    //Messages can also be queued without their file descriptor becoming readable, like the signals that arrive while a call blocks for its reply.
+    //libdbus reports those through the dispatch status, but may not be called from there, so update() is run from the loop instead.
+    update_timer = loop.addTimer([this]() { update(); });
+    dbus_connection_set_dispatch_status_function(connection, [](DBusConnection* connection, DBusDispatchStatus status, void* data)
+    {
+        Bus* bus = static_cast<Bus*>(data);
+        if (status == DBUS_DISPATCH_DATA_REMAINS)
+        {
+            bus->loop->setTimer(bus->update_timer, 0);
+        }
+    }, this, nullptr);
+    //Messages that arrived before are not signalled by the watches anymore.
+    update();
+}
+
+void Bus::updateWatches(int fd)
+{
+    int events = 0;
+    for(DBusWatch* watch : watches[fd])
+    {
+        if (!dbus_watch_get_enabled(watch))
+        {
+            continue;
+        }
+        unsigned int flags = dbus_watch_get_flags(watch);
+        if (flags & DBUS_WATCH_READABLE)
+        {
+            events |= EventLoop::Readable;
+        }
+        if (flags & DBUS_WATCH_WRITABLE)
+        {
+            events |= EventLoop::Writable;
+        }
+    }
+    if (events == 0)
+    {
+        loop->unwatch(fd);
+        return;
+    }
+    loop->watch(fd, events, [this, fd](int events) { handleWatches(fd, events); });
+}
+
+void Bus::handleWatches(int fd, int events)
+{
+    unsigned int flags = 0;
+    if (events & EventLoop::Readable)
+    {
+        flags |= DBUS_WATCH_READABLE;
+    }
+    if (events & EventLoop::Writable)
+    {
+        flags |= DBUS_WATCH_WRITABLE;
+    }
+    if (events & EventLoop::Error)
+    {
+        flags |= DBUS_WATCH_ERROR | DBUS_WATCH_HANGUP;
+    }
+    //Handling a watch can remove watches, so a copy of the list is used.
+    std::list<DBusWatch*> fd_watches = watches[fd];
+    for(DBusWatch* watch : fd_watches)
+    {
+        if (dbus_watch_get_enabled(watch))
+        {
+            dbus_watch_handle(watch, flags);
+        }
+    }
+    update();
+}
+
+unsigned int Bus::addWatch(DBusWatch* watch, void* data)
+{
+    Bus* bus = static_cast<Bus*>(data);
+    int fd = dbus_watch_get_unix_fd(watch);
+    bus->watches[fd].push_back(watch);
+    bus->updateWatches(fd);
+    return TRUE;
+}
+
+void Bus::removeWatch(DBusWatch* watch, void* data)
+{
+    Bus* bus = static_cast<Bus*>(data);
+    int fd = dbus_watch_get_unix_fd(watch);
+    bus->watches[fd].remove(watch);
+    if (bus->watches[fd].empty())
+    {
+        bus->watches.erase(fd);
+        bus->loop->unwatch(fd);
+        return;
+    }
+    bus->updateWatches(fd);
+}
+
+void Bus::toggleWatch(DBusWatch* watch, void* data)
+{
+    Bus* bus = static_cast<Bus*>(data);
+    bus->updateWatches(dbus_watch_get_unix_fd(watch));
+}
+
 Proxy::Proxy(const char* object_name, const char* object_path, const char* interface)
 {
     this->object_name = object_name;
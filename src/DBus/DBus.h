@@ -16,6 +16,7 @@
             Usage:  Create it from a DBus::Proxy class, fill it with parameters, call(), read the return values by the DBus::Message members.
 */
 
+#include <functional>
 #include <memory>
 #include <list>
 #include <map>
@@ -27,6 +28,8 @@
 struct DBusConnection;
 struct DBusMessage;
 struct DBusMessageIter;
+struct DBusWatch;
+class EventLoop;
 
 namespace DBus
 {
@@ -44,8 +47,21 @@ private:
 
     DBusConnection* connection;
     std::list<Proxy*> proxies;
+    EventLoop* loop;
+    //The watches of libdbus per file descriptor, there can be separate ones for reading and writing.
+    std::map<int, std::list<DBusWatch*>> watches;
+    //Timer of the loop that runs update(), for messages that libdbus queued without a watch noticing them.
+    int update_timer;
     
     Bus();
+
+    //Watch a file descriptor in the loop for the events of its enabled watches.
+    void updateWatches(int fd);
+    void handleWatches(int fd, int events);
+    //Functions required for libdbus to tell which file descriptors to watch.
+    static unsigned int addWatch(DBusWatch* watch, void* data);
+    static void removeWatch(DBusWatch* watch, void* data);
+    static void toggleWatch(DBusWatch* watch, void* data);
 public:
     static Bus* getInstance();
 
@@ -53,6 +69,12 @@ public:
     
     //Run an update cycle on the DBus connection, get all new incomming messages, and possibly handle signals.
     void update();
+
+    //Let the loop watch the connection, so incomming messages are handled as soon as they arrive, without calling update().
+    void attach(EventLoop& loop);
+
+    //False when there is no system bus to connect to, calls can't be made then.
+    bool isConnected() const;
     
     friend class Call;
     friend class Proxy;
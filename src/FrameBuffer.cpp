@@ -0,0 +1,105 @@
+#include "FrameBuffer.h"
+#include "Image/jpgd.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+static_assert(FrameBuffer::PADDING >= jpgd::JPGD_IN_PLACE_PAD_SIZE, "FrameBuffer padding too small to decode JPEGs in place");
+
+FrameBuffer::FrameBuffer()
+: data(nullptr), size(0), capacity(0)
+{
+}
+
+FrameBuffer::~FrameBuffer()
+{
+    free(data);
+}
+
+void FrameBuffer::reserve(size_t new_capacity)
+{
+    if (new_capacity <= capacity)
+    {
+        return;
+    }
+    if (new_capacity > SIZE_MAX - PADDING)
+    {
+        throw std::bad_alloc();
+    }
+    uint8_t* new_data = static_cast<uint8_t*>(realloc(data, new_capacity + PADDING));
+    if (!new_data)
+    {
+        throw std::bad_alloc();
+    }
+    data = new_data;
+    capacity = new_capacity;
+}
+
+void FrameBuffer::append(const char* new_data, size_t new_size)
+{
+    if (new_size > SIZE_MAX - size)
+    {
+        throw std::bad_alloc();
+    }
+    if (size + new_size > capacity)
+    {
+        // Grow in big steps, when no Content-Length was known in advance this keeps the number of re-allocations low.
+        size_t new_capacity = capacity * 2;
+        if (new_capacity < size + new_size)
+        {
+            new_capacity = size + new_size;
+        }
+        reserve(new_capacity);
+    }
+    memcpy(data + size, new_data, new_size);
+    size += new_size;
+}
+
+void FrameBuffer::truncate(size_t new_size)
+{
+    if (new_size < size)
+    {
+        size = new_size;
+    }
+}
+
+void FrameBuffer::clear()
+{
+    size = 0;
+}
+
+void FrameBuffer::swap(FrameBuffer& other)
+{
+    uint8_t* other_data = other.data;
+    size_t other_size = other.size;
+    size_t other_capacity = other.capacity;
+    other.data = data;
+    other.size = size;
+    other.capacity = capacity;
+    data = other_data;
+    size = other_size;
+    capacity = other_capacity;
+}
+
+size_t FrameBuffer::curlWrite(char* data, size_t size, size_t nmemb, FrameBuffer* buffer)
+{
+    return curlReceive(size * nmemb, [&]() { buffer->append(data, size * nmemb); });
+}
+
+size_t FrameBuffer::curlHeader(char* data, size_t size, size_t nmemb, FrameBuffer* buffer)
+{
+    static const char content_length_header[] = "Content-Length:";
+    size_t length = size * nmemb;
+    if (length > sizeof(content_length_header) && strncasecmp(data, content_length_header, sizeof(content_length_header) - 1) == 0)
+    {
+        // The header is not 0 terminated, but always ends in a newline, which stops strtoull.
+        unsigned long long content_length = strtoull(data + sizeof(content_length_header) - 1, nullptr, 10);
+        if (content_length > MAX_FRAME_SIZE)
+        {
+            return length;
+        }
+        return curlReceive(length, [&]() { buffer->reserve(content_length); });
+    }
+    return length;
+}
@@ -0,0 +1,84 @@
+#ifndef FRAME_BUFFER_H
+#define FRAME_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+
+#include "System/NoCopy.h"
+
+/** Byte buffer that holds a single JPEG frame as it is received.
+ *  The buffer only grows, so when it is re-used for the next frame no allocations are done.
+ *  There is always PADDING writable space after the data, so the JPEG decoder can decode it in place, without copying it first.
+ */
+class FrameBuffer : NoCopy
+{
+public:
+    // Extra bytes after the data, the JPEG decoder writes EOI markers here.
+    static const size_t PADDING = 128;
+    // No camera frame is larger than this. A larger Content-Length is not believed, so a bad header can't make us reserve any amount of memory.
+    static const size_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+
+    FrameBuffer();
+    ~FrameBuffer();
+
+    /** Make sure the buffer can hold at least size bytes of data (plus the padding), so receiving them needs no re-allocations.
+     *  Existing data is kept. Throws std::bad_alloc when the memory can't be allocated, or the size with the padding does not fit in a size_t.
+     */
+    void reserve(size_t size);
+
+    /** Add data at the end of the buffer, growing the buffer when needed. Throws std::bad_alloc like reserve().
+     */
+    void append(const char* data, size_t size);
+
+    /** Shrink the data to the given size. The capacity is kept.
+     */
+    void truncate(size_t size);
+
+    /** Empty the buffer. The capacity is kept.
+     */
+    void clear();
+
+    /** Exchange the contents of two buffers, without copying any data.
+     */
+    void swap(FrameBuffer& other);
+
+    uint8_t* getData() { return data; }
+    const uint8_t* getData() const { return data; }
+    size_t getSize() const { return size; }
+    size_t getCapacity() const { return capacity; }
+
+    /** Function required for the libcurl to write data directly into the buffer
+     */
+    static size_t curlWrite(char* data, size_t size, size_t nmemb, FrameBuffer* buffer);
+
+    /** Handle data received by libcurl in one of its callbacks.
+     *  Exceptions cannot pass through libcurl, so when the memory runs out the transfer is aborted instead, by returning less than the received size.
+     * /param size Size of the received data.
+     * /param receive Function that handles the data, and may throw std::bad_alloc.
+     * /returns the size for the callback to return to libcurl.
+     */
+    template<typename Receive>
+    static size_t curlReceive(size_t size, Receive receive)
+    {
+        try
+        {
+            receive();
+        } catch (const std::bad_alloc&)
+        {
+            return 0;
+        }
+        return size;
+    }
+
+    /** Function for the libcurl header callback, reserves room for the data as soon as the Content-Length header is received.
+     *  A Content-Length above MAX_FRAME_SIZE is ignored, the buffer then grows while the data is received.
+     */
+    static size_t curlHeader(char* data, size_t size, size_t nmemb, FrameBuffer* buffer);
+private:
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+};
+
+#endif //FRAME_BUFFER_H
@@ -0,0 +1,291 @@
+#include "FrameFetcher.h"
+#include "FrameSource.h"
+#include "MultipartParser.h"
+#include "System/Clock.h"
+
+#include <curl/curl.h>
+
+#include <algorithm>
+
+// Longest wait before a camera that keeps failing is tried again.
+static const uint64_t MAX_RETRY_INTERVAL_MS = 10000;
+// How long to wait before re-opening a stream after it failed.
+static const uint64_t RECONNECT_DELAY_MS = 1000;
+
+struct FrameFetcher::Transfer
+{
+    Transfer(FrameFetcher& fetcher, int id, const std::string& url, uint64_t interval)
+    : fetcher(fetcher), id(id), url(url), interval(interval), stream(FrameSource::isStreamUrl(url)), curl(nullptr)
+    , parser([this](FrameBuffer& part) { onPart(part); })
+    , active(false), start_time(0), next_start_time(0), last_part_time(0), failures(0)
+    {
+    }
+
+    // Hand a frame of a stream to the callback, unless the interval since the last one handed out did not pass yet.
+    void onPart(FrameBuffer& part)
+    {
+        uint64_t now = getMilliseconds();
+        if (interval > 0 && last_part_time > 0 && now < last_part_time + interval)
+        {
+            return;
+        }
+        last_part_time = now;
+        fetcher.frame_callback(id, part);
+    }
+
+    FrameFetcher& fetcher;
+    const int id;
+    const std::string url;
+    uint64_t interval;
+    const bool stream;
+    CURL* curl;
+    // Snapshots are received in here, streams through the parser.
+    FrameBuffer frame;
+    MultipartParser parser;
+    // Set while the transfer is added to the multi handle.
+    bool active;
+    uint64_t start_time;
+    uint64_t next_start_time;
+    // Time the last frame of a stream was handed out, frames of a stream are skipped to keep to the interval.
+    uint64_t last_part_time;
+    int failures;
+};
+
+FrameFetcher::FrameFetcher(EventLoop& loop, frame_callback_t frame_callback, error_callback_t error_callback)
+: frame_callback(frame_callback), error_callback(error_callback), loop(loop), started(false)
+{
+    multi = curl_multi_init();
+    if (!multi)
+    {
+        throw std::string("Unable to initialize curl multi");
+    }
+    curl_timer = loop.addTimer([this]() { onSocket(CURL_SOCKET_TIMEOUT, 0); });
+    start_timer = loop.addTimer([this]() { startTransfers(); });
+
+    curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, &FrameFetcher::curlSocket);
+    curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, this);
+    curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, &FrameFetcher::curlTimer);
+    curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+}
+
+FrameFetcher::~FrameFetcher()
+{
+    stop();
+    for (std::unique_ptr<Transfer>& transfer : transfers)
+    {
+        curl_easy_cleanup(transfer->curl);
+    }
+    curl_multi_cleanup(multi);
+    loop.removeTimer(curl_timer);
+    loop.removeTimer(start_timer);
+}
+
+int FrameFetcher::addCamera(const std::string& url, uint64_t interval)
+{
+    Transfer* transfer = new Transfer(*this, transfers.size(), url, interval);
+    transfers.push_back(std::unique_ptr<Transfer>(transfer));
+
+    CURL* curl = curl_easy_init();
+    if(!curl)
+    {
+        throw std::string("Unable to initialize curl");
+    }
+    transfer->curl = curl;
+    curl_easy_setopt(curl, CURLOPT_URL, transfer->url.c_str());
+    curl_easy_setopt(curl, CURLOPT_PRIVATE, transfer);
+    if (transfer->stream)
+    {
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &FrameFetcher::curlStreamWrite);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, transfer);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &FrameFetcher::curlStreamHeader);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, transfer);
+        // A stream that stops sending data is considered dead, and will be re-opened.
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+        curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 5L);
+    } else
+    {
+        // Like the FrameGrabber, curl writes directly into the frame buffer.
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &FrameBuffer::curlWrite);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer->frame);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &FrameBuffer::curlHeader);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &transfer->frame);
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 5000L);
+    }
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, 2000L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+    return transfer->id;
+}
+
+void FrameFetcher::setInterval(int id, uint64_t interval)
+{
+    Transfer& transfer = *transfers[id];
+    transfer.interval = interval;
+    // A snapshot that waits for its next request is rescheduled, so a shorter interval takes effect right away. A camera that is failing keeps backing off.
+    if (!transfer.stream && !transfer.active && transfer.failures == 0)
+    {
+        transfer.next_start_time = transfer.start_time + interval;
+        // Not started from here, this may be called from the frame callback while the frame of the transfer is still in use.
+        if (started)
+        {
+            loop.setTimer(start_timer, 0);
+        }
+    }
+}
+
+void FrameFetcher::start()
+{
+    started = true;
+    startTransfers();
+}
+
+void FrameFetcher::stop()
+{
+    started = false;
+    loop.setTimer(start_timer, -1);
+    // Removing the handles aborts their transfers, they are started again by the next start().
+    for (std::unique_ptr<Transfer>& transfer : transfers)
+    {
+        if (transfer->active)
+        {
+            curl_multi_remove_handle(multi, transfer->curl);
+            transfer->active = false;
+        }
+    }
+}
+
+void FrameFetcher::onSocket(int socket, int events)
+{
+    int flags = 0;
+    if (events & EventLoop::Readable)
+    {
+        flags |= CURL_CSELECT_IN;
+    }
+    if (events & EventLoop::Writable)
+    {
+        flags |= CURL_CSELECT_OUT;
+    }
+    if (events & EventLoop::Error)
+    {
+        flags |= CURL_CSELECT_ERR;
+    }
+    int running_handles;
+    curl_multi_socket_action(multi, socket, flags, &running_handles);
+    finishTransfers();
+}
+
+void FrameFetcher::startTransfers()
+{
+    if (!started)
+    {
+        return;
+    }
+    uint64_t now = getMilliseconds();
+    long timeout = -1;
+    for (std::unique_ptr<Transfer>& transfer : transfers)
+    {
+        if (transfer->active)
+        {
+            continue;
+        }
+        if (transfer->next_start_time > now)
+        {
+            long wait = static_cast<long>(transfer->next_start_time - now);
+            timeout = timeout < 0 ? wait : std::min(timeout, wait);
+            continue;
+        }
+        // The buffers keep their capacity, so after the first frame receiving needs no allocations.
+        transfer->frame.clear();
+        transfer->parser.reset();
+        transfer->start_time = now;
+        transfer->active = true;
+        // Adding the handle makes curl set a timeout of 0 through curlTimer(), the transfer really starts when that timer expires.
+        curl_multi_add_handle(multi, transfer->curl);
+    }
+    loop.setTimer(start_timer, timeout);
+}
+
+void FrameFetcher::finishTransfers()
+{
+    bool finished = false;
+    int message_count;
+    while(CURLMsg* message = curl_multi_info_read(multi, &message_count))
+    {
+        if (message->msg != CURLMSG_DONE)
+        {
+            continue;
+        }
+        Transfer* transfer;
+        curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, &transfer);
+        CURLcode result = message->data.result;
+        curl_multi_remove_handle(multi, transfer->curl);
+        transfer->active = false;
+
+        uint64_t now = getMilliseconds();
+        if (result == CURLE_OK && !transfer->stream)
+        {
+            transfer->failures = 0;
+            frame_callback(transfer->id, transfer->frame);
+            transfer->next_start_time = transfer->start_time + transfer->interval;
+        } else
+        {
+            // A stream only ends when something went wrong.
+            transfer->failures++;
+            error_callback(transfer->id, result == CURLE_OK ? "stream ended" : curl_easy_strerror(result));
+            // Back off from a camera that keeps failing, so it does not take time from the others.
+            uint64_t delay = std::max(transfer->interval, RECONNECT_DELAY_MS) * transfer->failures;
+            transfer->next_start_time = now + std::min(delay, MAX_RETRY_INTERVAL_MS);
+        }
+        finished = true;
+    }
+    if (finished)
+    {
+        startTransfers();
+    }
+}
+
+size_t FrameFetcher::curlStreamWrite(char* data, size_t size, size_t nmemb, Transfer* transfer)
+{
+    // A stream that delivers data is working again.
+    transfer->failures = 0;
+    return FrameBuffer::curlReceive(size * nmemb, [&]() { transfer->parser.feed(data, size * nmemb); });
+}
+
+size_t FrameFetcher::curlStreamHeader(char* data, size_t size, size_t nmemb, Transfer* transfer)
+{
+    std::string line(data, size * nmemb);
+    std::string boundary = MultipartParser::parseBoundary(line);
+    if (!boundary.empty())
+    {
+        transfer->parser.setBoundary(boundary);
+    }
+    return size * nmemb;
+}
+
+int FrameFetcher::curlSocket(CURL* curl, int socket, int what, FrameFetcher* fetcher, void* socket_data)
+{
+    if (what == CURL_POLL_REMOVE)
+    {
+        fetcher->loop.unwatch(socket);
+        return 0;
+    }
+    int events = 0;
+    if (what & CURL_POLL_IN)
+    {
+        events |= EventLoop::Readable;
+    }
+    if (what & CURL_POLL_OUT)
+    {
+        events |= EventLoop::Writable;
+    }
+    fetcher->loop.watch(socket, events, [fetcher, socket](int events) { fetcher->onSocket(socket, events); });
+    return 0;
+}
+
+int FrameFetcher::curlTimer(CURLM* multi, long timeout_ms, FrameFetcher* fetcher)
+{
+    // -1 stops the timer, like it does for the EventLoop.
+    fetcher->loop.setTimer(fetcher->curl_timer, timeout_ms);
+    return 0;
+}
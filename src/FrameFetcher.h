@@ -0,0 +1,93 @@
+#ifndef FRAME_FETCHER_H
+#define FRAME_FETCHER_H
+
+#include <stdint.h>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FrameBuffer.h"
+#include "System/EventLoop.h"
+#include "System/NoCopy.h"
+
+// CURL is a c lib, so this is the 'forward declaration'
+typedef void CURL;
+typedef void CURLM;
+
+/** The FrameFetcher receives the frames of many cameras on the thread of an EventLoop.
+ *  All transfers run on one curl multi handle. curl tells which sockets to watch through its socket callback, and the EventLoop waits for all of them,
+ *  so the number of cameras is not limited by the number of threads, and an idle camera costs nothing.
+ *  The timeouts of curl and the interval between snapshots are timers of the EventLoop, so nothing is polled.
+ *  Snapshot URLs are requested again at the interval of the camera, mjpg-streamer "?action=stream" URLs are kept open and split into frames by a MultipartParser.
+ *  Like the FrameGrabber, curl writes the received data directly into a frame buffer of the camera, which is re-used for every frame.
+ */
+class FrameFetcher : NoCopy
+{
+public:
+    /** Called on the thread of the EventLoop for every complete frame.
+     *  The callback may swap the contents of the frame with another FrameBuffer, the fetcher clears the frame and re-uses it for the next one.
+     *  The next frame of the camera is only received after the callback returns, so it should not do more than queue the frame.
+     */
+    typedef std::function<void(int id, FrameBuffer& frame)> frame_callback_t;
+
+    /** Called on the thread of the EventLoop when a transfer failed, with a description of the error.
+     */
+    typedef std::function<void(int id, const char* error)> error_callback_t;
+
+    /** Create a fetcher without cameras.
+     * /param loop EventLoop to receive the frames on. The fetcher should only be used on its thread, or while it is not running.
+     */
+    FrameFetcher(EventLoop& loop, frame_callback_t frame_callback, error_callback_t error_callback);
+    ~FrameFetcher();
+
+    /** Add a camera. Cameras can only be added before start().
+     * /param url Snapshot or stream URL of the camera.
+     * /param interval Milliseconds between the start of two snapshot requests. Frames of streams that arrive sooner after the last one are skipped.
+     * /returns id of the camera, passed to the callbacks. Ids are numbered from 0 in the order the cameras are added.
+     */
+    int addCamera(const std::string& url, uint64_t interval);
+
+    /** Change the interval of a camera, see addCamera(). Can be called while the fetcher runs, also from the frame callback.
+     *  A snapshot that waits for its next request is rescheduled by the start timer, it's never started from here.
+     */
+    void setInterval(int id, uint64_t interval);
+
+    /** Start receiving frames, as soon as the EventLoop runs.
+     */
+    void start();
+
+    /** Stop receiving frames, and abort all transfers in progress.
+     */
+    void stop();
+private:
+    struct Transfer;
+
+    /** Functions required for the libcurl to hand us the received data of streams, and to tell which sockets to watch.
+     */
+    static size_t curlStreamWrite(char* data, size_t size, size_t nmemb, Transfer* transfer);
+    static size_t curlStreamHeader(char* data, size_t size, size_t nmemb, Transfer* transfer);
+    static int curlSocket(CURL* curl, int socket, int what, FrameFetcher* fetcher, void* socket_data);
+    static int curlTimer(CURLM* multi, long timeout_ms, FrameFetcher* fetcher);
+
+    // Let curl handle a socket that is ready, or its timeout when socket is CURL_SOCKET_TIMEOUT.
+    void onSocket(int socket, int events);
+    // Start the transfers that are due, and set the start timer to the next one.
+    void startTransfers();
+    // Hand out the frames of the transfers that completed, and schedule their next request.
+    void finishTransfers();
+
+    frame_callback_t frame_callback;
+    error_callback_t error_callback;
+    std::vector<std::unique_ptr<Transfer>> transfers;
+
+    EventLoop& loop;
+    CURLM* multi;
+    // Timer for the timeouts of curl.
+    int curl_timer;
+    // Timer for the next transfer to start.
+    int start_timer;
+    bool started;
+};
+
+#endif //FRAME_FETCHER_H
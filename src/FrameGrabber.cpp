@@ -0,0 +1,106 @@
+#include "FrameGrabber.h"
+#include <curl/curl.h>
+
+FrameGrabber::FrameGrabber(std::string url): url(url), stream(frame), grab_requested(false), grab_done(false), received(false), stopping(false)
+{
+    curl = curl_easy_init();
+    if(!curl)
+    {
+        throw std::string("Unable to initialize curl");
+    }
+    // The data goes into the frame buffer through the stream, so a decoder can read it while it is received.
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &JpegPushStream::curlWrite);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &stream);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &JpegPushStream::curlHeader);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, &stream);
+    curl_easy_setopt(curl, CURLOPT_URL, this->url.c_str());
+    // The connection stays open between frames because the same easy handle is re-used for every request.
+    // Keepalive only makes TCP send probes while the connection is idle, so one to a camera that went away is dropped instead of re-used.
+    // The timeouts make sure a request to a dead camera doesn't hang.
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, 2000L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 5000L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+}
+
+FrameGrabber::~FrameGrabber()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    condition.notify_all();
+    if (receive_thread.joinable())
+    {
+        receive_thread.join();
+    }
+    curl_easy_cleanup(curl);
+}
+
+bool FrameGrabber::grab()
+{
+    // begin() clears the frame, which keeps the capacity of the buffer, so after the first frame no more allocations are done.
+    stream.begin();
+    return receive();
+}
+
+jpgd::jpeg_decoder_stream* FrameGrabber::startGrab()
+{
+    // The stream is started here, and not on the thread, so the decoder can't read anything of the previous frame.
+    stream.begin();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!receive_thread.joinable())
+        {
+            receive_thread = std::thread(&FrameGrabber::receiveMain, this);
+        }
+        grab_requested = true;
+        grab_done = false;
+    }
+    condition.notify_all();
+    return &stream;
+}
+
+bool FrameGrabber::finishGrab()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [this]() { return grab_done; });
+    return received;
+}
+
+void FrameGrabber::receiveMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        condition.wait(lock, [this]() { return stopping || grab_requested; });
+        if (stopping)
+        {
+            return;
+        }
+        grab_requested = false;
+
+        // The curl handle is only used by this thread until the request is done, so it's not guarded by the mutex.
+        lock.unlock();
+        bool ok = receive();
+        lock.lock();
+
+        received = ok;
+        grab_done = true;
+        condition.notify_all();
+    }
+}
+
+bool FrameGrabber::receive()
+{
+    bool ok = curl_easy_perform(curl) == CURLE_OK;
+    // Also on errors, so a decoder reading from the stream does not wait forever.
+    stream.finish();
+    return ok;
+}
+
+FrameBuffer& FrameGrabber::getFrame()
+{
+    return frame;
+}
@@ -0,0 +1,74 @@
+#ifndef FRAME_GRABBER_H
+#define FRAME_GRABBER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "FrameSource.h"
+#include "JpegPushStream.h"
+
+// CURL is a c lib, so this is the 'forward declaration'
+typedef void CURL;
+
+/** The FrameGrabber fetches frames from a camera snapshot URL, one request per frame.
+ *  Unlike the CurlRequest, it is meant to live as long as the camera is polled.
+ *  It keeps a single curl handle, so the connection to the camera is re-used between frames,
+ *  and the frame buffer keeps its capacity so it is not re-allocated for every frame.
+ *  curl writes the received data directly into the frame buffer.
+ *  With startGrab() the request is done on a background thread, and the frame can be decoded while it is received.
+ *  That thread is started with the first startGrab(), and then waits for the next one, so no thread is created per frame.
+ */
+class FrameGrabber : public FrameSource
+{
+public:
+    /** Create a grabber for the given URL. No request is done until grab() is called.
+     * /param url URL from which to grab the frames.
+     */
+    FrameGrabber(std::string url);
+    ~FrameGrabber();
+
+    /** Fetch a new frame from the URL.
+     * /returns true if a complete frame was received, false on any transfer or HTTP error.
+     */
+    virtual bool grab();
+
+    /** Get the last grabbed frame.
+     *  The frame is only valid until the next call to grab().
+     */
+    virtual FrameBuffer& getFrame();
+
+    /** Start fetching a new frame on a background thread.
+     * /returns stream that delivers the data of the frame while it is received.
+     */
+    virtual jpgd::jpeg_decoder_stream* startGrab();
+
+    /** Wait for the frame started by startGrab().
+     * /returns true if a complete frame was received, false on any transfer or HTTP error.
+     */
+    virtual bool finishGrab();
+protected:
+    // Do the request for a frame, the stream must be started.
+    bool receive();
+    // Body of the receive_thread, does the requests started by startGrab().
+    void receiveMain();
+
+    std::string url;
+    CURL* curl;
+    FrameBuffer frame;
+    JpegPushStream stream;
+    std::thread receive_thread;
+
+    // The fields below are guarded by the mutex, the condition is notified when any of them changes.
+    std::mutex mutex;
+    std::condition_variable condition;
+    // Set by startGrab() for the receive_thread.
+    bool grab_requested;
+    // Set by the receive_thread when the request is done, with its result in received.
+    bool grab_done;
+    bool received;
+    bool stopping;
+};
+
+#endif //FRAME_GRABBER_H
@@ -0,0 +1,17 @@
+#include "FrameSource.h"
+#include "FrameGrabber.h"
+#include "MjpegStream.h"
+
+FrameSource* FrameSource::create(std::string url)
+{
+    if (isStreamUrl(url))
+    {
+        return new MjpegStream(url);
+    }
+    return new FrameGrabber(url);
+}
+
+bool FrameSource::isStreamUrl(const std::string& url)
+{
+    return url.find("action=stream") != std::string::npos;
+}
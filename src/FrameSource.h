@@ -0,0 +1,56 @@
+#ifndef FRAME_SOURCE_H
+#define FRAME_SOURCE_H
+
+#include <string>
+
+#include "FrameBuffer.h"
+#include "System/NoCopy.h"
+
+namespace jpgd
+{
+    class jpeg_decoder_stream;
+}
+
+/** Interface for anything that delivers JPEG frames from a camera.
+ *  Implemented by the FrameGrabber (one HTTP request per snapshot) and the MjpegStream (one continuous multipart stream).
+ */
+class FrameSource : NoCopy
+{
+public:
+    virtual ~FrameSource() {}
+
+    /** Get a new frame from the camera.
+     * /returns true if a new frame is available through getFrame().
+     */
+    virtual bool grab() = 0;
+
+    /** Get the last grabbed frame.
+     *  The frame stays owned by the source, and is only valid until the next call to grab().
+     *  It's not const, so it can be decoded in place.
+     */
+    virtual FrameBuffer& getFrame() = 0;
+
+    /** Start getting a new frame in the background, and return a stream that delivers its data while it is being received.
+     *  This way the frame can be decoded while it is still arriving. finishGrab() must be called before starting the next frame.
+     * /returns the stream to decode the frame from, or nullptr when the source does not support this (the default), grab() should be used then.
+     */
+    virtual jpgd::jpeg_decoder_stream* startGrab() { return nullptr; }
+
+    /** Wait until the frame started by startGrab() was received completely.
+     * /returns true if a new frame is available through getFrame(), like grab().
+     */
+    virtual bool finishGrab() { return false; }
+
+    /** Create the right frame source for the URL.
+     *  mjpg-streamer "?action=stream" URLs get a MjpegStream, anything else is fetched as a snapshot.
+     * /param url URL of the camera.
+     * /returns new FrameSource, owned by the caller.
+     */
+    static FrameSource* create(std::string url);
+
+    /** Check if an URL points to a continuous mjpg-streamer stream instead of a single snapshot.
+     */
+    static bool isStreamUrl(const std::string& url);
+};
+
+#endif //FRAME_SOURCE_H
@@ -0,0 +1,38 @@
+#include "ChangeDetector.h"
+
+#include <stdlib.h>
+
+ChangeDetector::ChangeDetector(int threshold)
+: threshold(threshold), reference_width(0), reference_height(0)
+{
+}
+
+void ChangeDetector::setThreshold(int threshold)
+{
+    this->threshold = threshold;
+    reset();
+}
+
+bool ChangeDetector::update(const uint8_t* thumbnail, int width, int height)
+{
+    bool changed = threshold <= 0 || width != reference_width || height != reference_height || reference.empty();
+    for (size_t i = 0; !changed && i < reference.size(); i++)
+    {
+        changed = abs(thumbnail[i] - reference[i]) > threshold;
+    }
+    if (changed)
+    {
+        // assign() keeps the capacity, so after the first frame this does not allocate.
+        reference.assign(thumbnail, thumbnail + width * height);
+        reference_width = width;
+        reference_height = height;
+    }
+    return changed;
+}
+
+void ChangeDetector::reset()
+{
+    reference.clear();
+    reference_width = 0;
+    reference_height = 0;
+}
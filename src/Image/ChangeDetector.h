@@ -0,0 +1,45 @@
+#ifndef CHANGE_DETECTOR_H
+#define CHANGE_DETECTOR_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "System/NoCopy.h"
+
+/** Tells whether the scene seen by a camera changed, by comparing small thumbnails of the frames.
+ *  A thumbnail is compared with the one of the last frame that counted as changed, not with the one of the previous frame,
+ *  so a slow change (like the light of the day) is noticed as well once it adds up.
+ *  Each pixel of a thumbnail averages a block of the frame, so the noise of the camera hardly shows in it,
+ *  and a code that appears in any part of the frame changes at least a few pixels a lot.
+ */
+class ChangeDetector : public NoCopy
+{
+public:
+    /** /param threshold See setThreshold().
+     */
+    ChangeDetector(int threshold = 10);
+
+    /** Set how much a pixel of the thumbnail has to change for the scene to count as changed.
+     * /param threshold Difference in grey levels. 0 counts every frame as changed.
+     */
+    void setThreshold(int threshold);
+
+    /** Compare the thumbnail of a frame with the last changed one.
+     *  The first thumbnail, and one of another size, always count as changed.
+     * /param thumbnail width * height luminance pixels.
+     * /returns true if the scene changed. The thumbnail is kept to compare the next ones with then.
+     */
+    bool update(const uint8_t* thumbnail, int width, int height);
+
+    /** Forget the last thumbnail, so the next one counts as changed.
+     */
+    void reset();
+
+private:
+    int threshold;
+    std::vector<uint8_t> reference;
+    int reference_width;
+    int reference_height;
+};
+
+#endif //CHANGE_DETECTOR_H
@@ -0,0 +1,75 @@
+#include "GrayConvert.h"
+#include "jpgd_simd.h"
+
+#include <string.h>
+
+void convertRGBToGray(const uint8_t* pixels, uint8_t* gray, int count, int comps)
+{
+    for (int x = 0; x < count; x++)
+    {
+        // 0x200 = 1<<9, half an lsb of the result to force rounding
+        gray[x] = (306 * pixels[0] + 601 * pixels[1] + 117 * pixels[2] + 0x200) >> 10;
+        pixels += comps;
+    }
+}
+
+namespace
+{
+    void convertGray(const uint8_t* pixels, uint8_t* gray, int count)
+    {
+        memcpy(gray, pixels, count);
+    }
+
+    void convertGrayAlpha(const uint8_t* pixels, uint8_t* gray, int count)
+    {
+        for (int x = 0; x < count; x++)
+        {
+            gray[x] = pixels[x * 2];
+        }
+    }
+
+    void convertRGB(const uint8_t* pixels, uint8_t* gray, int count)
+    {
+        convertRGBToGray(pixels, gray, count, 3);
+    }
+
+    void convertRGBA(const uint8_t* pixels, uint8_t* gray, int count)
+    {
+        convertRGBToGray(pixels, gray, count, 4);
+    }
+}
+
+GrayConvertFunction getGrayConvertFunction(int comps)
+{
+    // The kernels are picked for the same instruction set as the ones of jpgd.
+    switch(comps)
+    {
+        case 1: return convertGray;
+        case 2: return convertGrayAlpha;
+        case 3:
+            switch(jpgd::get_simd_support())
+            {
+#if defined(JPGD_SIMD_X86)
+                case jpgd::SIMD_AVX2: return convertRGBToGrayAVX2;
+                case jpgd::SIMD_SSE2: return convertRGBToGraySSE2;
+#endif
+#if defined(JPGD_SIMD_NEON)
+                case jpgd::SIMD_NEON: return convertRGBToGrayNEON;
+#endif
+                default: return convertRGB;
+            }
+        case 4:
+            switch(jpgd::get_simd_support())
+            {
+#if defined(JPGD_SIMD_X86)
+                case jpgd::SIMD_AVX2: return convertRGBAToGrayAVX2;
+                case jpgd::SIMD_SSE2: return convertRGBAToGraySSE2;
+#endif
+#if defined(JPGD_SIMD_NEON)
+                case jpgd::SIMD_NEON: return convertRGBAToGrayNEON;
+#endif
+                default: return convertRGBA;
+            }
+        default: return nullptr;
+    }
+}
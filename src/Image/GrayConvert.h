@@ -0,0 +1,34 @@
+#ifndef GRAY_CONVERT_H
+#define GRAY_CONVERT_H
+
+#include <stdint.h>
+
+/** Function that converts count pixels into 8-bit luminance, one byte per pixel.
+ *  RGB(A) pixels are converted with (306 * R + 601 * G + 117 * B + 0x200) >> 10, gray(+alpha) pixels are used as is.
+ */
+typedef void (*GrayConvertFunction)(const uint8_t* pixels, uint8_t* gray, int count);
+
+/** Get the fastest conversion the CPU supports for pixels of comps bytes.
+ * /param comps 1 for gray, 2 for gray+alpha, 3 for RGB and 4 for RGBA.
+ * /returns the conversion, or nullptr for any other number of components.
+ */
+GrayConvertFunction getGrayConvertFunction(int comps);
+
+// SIMD versions of the RGB(A) conversion, each in its own file, compiled with the flags of its instruction set.
+// They give exactly the same output as the plain versions in GrayConvert.cpp.
+#if defined(JPGD_SIMD_X86)
+void convertRGBAToGraySSE2(const uint8_t* pixels, uint8_t* gray, int count);
+void convertRGBToGraySSE2(const uint8_t* pixels, uint8_t* gray, int count);
+void convertRGBAToGrayAVX2(const uint8_t* pixels, uint8_t* gray, int count);
+void convertRGBToGrayAVX2(const uint8_t* pixels, uint8_t* gray, int count);
+#endif
+#if defined(JPGD_SIMD_NEON)
+void convertRGBAToGrayNEON(const uint8_t* pixels, uint8_t* gray, int count);
+void convertRGBToGrayNEON(const uint8_t* pixels, uint8_t* gray, int count);
+#endif
+
+/** Plain conversion of pixels of comps (3 or 4) bytes. The SIMD versions use it for the pixels at the end of a row.
+ */
+void convertRGBToGray(const uint8_t* pixels, uint8_t* gray, int count, int comps);
+
+#endif //GRAY_CONVERT_H
@@ -0,0 +1,55 @@
+// AVX2 versions of the RGB(A) to luminance conversion, see GrayConvert.h. Compiled with -mavx2.
+#include "GrayConvert.h"
+
+#include <immintrin.h>
+
+namespace
+{
+    // Luminance of two groups of 4 pixels of 4 bytes, the 4th byte (alpha) is ignored.
+    // The result is in the order of vphaddd: pixels 0, 1, 4, 5 in the low lane, and 2, 3, 6, 7 in the high lane.
+    inline __m256i convert8(__m128i a, __m128i b)
+    {
+        const __m256i weights = _mm256_setr_epi16(306, 601, 117, 0, 306, 601, 117, 0, 306, 601, 117, 0, 306, 601, 117, 0);
+        __m256i sum = _mm256_hadd_epi32(_mm256_madd_epi16(_mm256_cvtepu8_epi16(a), weights), _mm256_madd_epi16(_mm256_cvtepu8_epi16(b), weights));
+        return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(0x200)), 10);
+    }
+
+    // Store the luminance of 16 pixels, converted by convert8() from pixels 0-7 and 8-15.
+    inline void store16(uint8_t* gray, __m256i a, __m256i b)
+    {
+        // Pairs of pixels 0-1, 4-5, 8-9, 12-13 in the low lane, and 2-3, 6-7, 10-11, 14-15 in the high lane.
+        __m256i words = _mm256_packs_epi32(a, b);
+        words = _mm256_permutevar8x32_epi32(words, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gray), _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1)));
+    }
+
+    // 4 pixels of 3 bytes, spread out to 4 bytes per pixel. Reads 4 bytes past the 4th pixel.
+    inline __m128i load4RGB(const uint8_t* pixels)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels)), shuffle);
+    }
+}
+
+void convertRGBAToGrayAVX2(const uint8_t* pixels, uint8_t* gray, int count)
+{
+    int x = 0;
+    for ( ; x + 16 <= count; x += 16)
+    {
+        const __m128i* p = reinterpret_cast<const __m128i*>(pixels + x * 4);
+        store16(gray + x, convert8(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)), convert8(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+    }
+    convertRGBToGray(pixels + x * 4, gray + x, count - x, 4);
+}
+
+void convertRGBToGrayAVX2(const uint8_t* pixels, uint8_t* gray, int count)
+{
+    int x = 0;
+    // The last load reads 4 bytes past the 16 pixels, so two more pixels must follow.
+    for ( ; x + 18 <= count; x += 16)
+    {
+        const uint8_t* p = pixels + x * 3;
+        store16(gray + x, convert8(load4RGB(p), load4RGB(p + 12)), convert8(load4RGB(p + 24), load4RGB(p + 36)));
+    }
+    convertRGBToGray(pixels + x * 3, gray + x, count - x, 3);
+}
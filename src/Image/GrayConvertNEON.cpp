@@ -0,0 +1,45 @@
+// NEON versions of the RGB(A) to luminance conversion, see GrayConvert.h.
+#include "GrayConvert.h"
+
+#include <arm_neon.h>
+
+namespace
+{
+    // Luminance of 8 pixels, from the separated R, G and B bytes.
+    inline uint8x8_t convert8(uint8x8_t r8, uint8x8_t g8, uint8x8_t b8)
+    {
+        uint16x8_t r = vmovl_u8(r8);
+        uint16x8_t g = vmovl_u8(g8);
+        uint16x8_t b = vmovl_u8(b8);
+        uint32x4_t lo = vmull_n_u16(vget_low_u16(r), 306);
+        lo = vmlal_n_u16(lo, vget_low_u16(g), 601);
+        lo = vmlal_n_u16(lo, vget_low_u16(b), 117);
+        uint32x4_t hi = vmull_n_u16(vget_high_u16(r), 306);
+        hi = vmlal_n_u16(hi, vget_high_u16(g), 601);
+        hi = vmlal_n_u16(hi, vget_high_u16(b), 117);
+        // The rounding shift adds the 0x200.
+        return vmovn_u16(vcombine_u16(vrshrn_n_u32(lo, 10), vrshrn_n_u32(hi, 10)));
+    }
+}
+
+void convertRGBAToGrayNEON(const uint8_t* pixels, uint8_t* gray, int count)
+{
+    int x = 0;
+    for ( ; x + 8 <= count; x += 8)
+    {
+        uint8x8x4_t p = vld4_u8(pixels + x * 4);
+        vst1_u8(gray + x, convert8(p.val[0], p.val[1], p.val[2]));
+    }
+    convertRGBToGray(pixels + x * 4, gray + x, count - x, 4);
+}
+
+void convertRGBToGrayNEON(const uint8_t* pixels, uint8_t* gray, int count)
+{
+    int x = 0;
+    for ( ; x + 8 <= count; x += 8)
+    {
+        uint8x8x3_t p = vld3_u8(pixels + x * 3);
+        vst1_u8(gray + x, convert8(p.val[0], p.val[1], p.val[2]));
+    }
+    convertRGBToGray(pixels + x * 3, gray + x, count - x, 3);
+}
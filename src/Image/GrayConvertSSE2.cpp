@@ -0,0 +1,60 @@
+// SSE2 versions of the RGB(A) to luminance conversion, see GrayConvert.h. Compiled with -msse2.
+#include "GrayConvert.h"
+
+#include <emmintrin.h>
+#include <string.h>
+
+namespace
+{
+    // Luminance of 4 pixels of 4 bytes, the 4th byte (alpha) is ignored. The weighted sums are done in 32 bits by pmaddwd.
+    inline __m128i convert4(__m128i pixels)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i weights = _mm_setr_epi16(306, 601, 117, 0, 306, 601, 117, 0);
+        // Per pixel 306 * R + 601 * G and 117 * B.
+        __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), weights);
+        __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), weights);
+        __m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(2, 0, 2, 0)));
+        __m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(lo), _mm_castsi128_ps(hi), _MM_SHUFFLE(3, 1, 3, 1)));
+        return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(even, odd), _mm_set1_epi32(0x200)), 10);
+    }
+
+    inline void store16(uint8_t* gray, __m128i a, __m128i b, __m128i c, __m128i d)
+    {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(gray), _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+    }
+
+    // 4 pixels of 3 bytes, spread out to 4 bytes per pixel. Reads 1 byte past the 4th pixel.
+    inline __m128i load4RGB(const uint8_t* pixels)
+    {
+        int32_t p[4];
+        for (int i = 0; i < 4; i++)
+        {
+            memcpy(&p[i], pixels + i * 3, 4);
+        }
+        return _mm_setr_epi32(p[0], p[1], p[2], p[3]);
+    }
+}
+
+void convertRGBAToGraySSE2(const uint8_t* pixels, uint8_t* gray, int count)
+{
+    int x = 0;
+    for ( ; x + 16 <= count; x += 16)
+    {
+        const __m128i* p = reinterpret_cast<const __m128i*>(pixels + x * 4);
+        store16(gray + x, convert4(_mm_loadu_si128(p)), convert4(_mm_loadu_si128(p + 1)), convert4(_mm_loadu_si128(p + 2)), convert4(_mm_loadu_si128(p + 3)));
+    }
+    convertRGBToGray(pixels + x * 4, gray + x, count - x, 4);
+}
+
+void convertRGBToGraySSE2(const uint8_t* pixels, uint8_t* gray, int count)
+{
+    int x = 0;
+    // SSE2 has no byte shuffle, so the pixels are loaded 4 bytes at a time. The last load reads the first byte of the next pixel, so one pixel must follow.
+    for ( ; x + 16 < count; x += 16)
+    {
+        const uint8_t* p = pixels + x * 3;
+        store16(gray + x, convert4(load4RGB(p)), convert4(load4RGB(p + 12)), convert4(load4RGB(p + 24)), convert4(load4RGB(p + 36)));
+    }
+    convertRGBToGray(pixels + x * 3, gray + x, count - x, 3);
+}
@@ -20,57 +20,73 @@
 #include <sstream>
 #include <cstdlib>
 #include <algorithm>
+#include <cstring>
 
-char ImageReaderSource::convertPixel(char const* pixel_) const
+ImageReaderSource::ImageReaderSource(zxing::ArrayRef<char> image_, int width, int height, int comps_)
+    : LuminanceSource(width, height), image(image_), comps(comps_), convert(getGrayConvertFunction(comps_))
 {
-    unsigned char const* pixel = (unsigned char const*) pixel_;
-    if (comps == 1 || comps == 2) // Gray or gray+alpha
-    {
-        return pixel[0];
-    }
-
-    if (comps == 3 || comps == 4)
-    {
-        // Red, Green, Blue, (Alpha)
-        // We assume 16 bit values here
-        // 0x200 = 1<<9, half an lsb of the result to force rounding
-        return (char)((306 * (int)pixel[0] + 601 * (int)pixel[1] +117 * (int)pixel[2] + 0x200) >> 10);
-    } else
+    if (!convert)
     {
         throw zxing::IllegalArgumentException("Unexpected image depth");
     }
 }
 
-ImageReaderSource::ImageReaderSource(zxing::ArrayRef<char> image_, int width, int height, int comps_)
-    : LuminanceSource(width, height), image(image_), comps(comps_) {}
-
 zxing::ArrayRef<char> ImageReaderSource::getRow(int y, zxing::ArrayRef<char> row) const
 {
-    const char* pixelRow = &image[0] + y * getWidth() * 4;
     if (!row)
     {
         row = zxing::ArrayRef<char>(getWidth());
     }
-    for (int x = 0; x < getWidth(); x++)
-    {
-        row[x] = convertPixel(pixelRow + (x * 4));
-    }
+    // The row is copied from the luminance matrix, so the image is converted only once, however often zxing asks for its rows.
+    zxing::ArrayRef<char> matrix = getMatrix();
+    memcpy(&row[0], &matrix[y * getWidth()], getWidth());
     return row;
 }
 
 zxing::ArrayRef<char> ImageReaderSource::getMatrix() const
 {
-    const char* p = &image[0];
-    zxing::ArrayRef<char> matrix(getWidth() * getHeight());
-    char* m = &matrix[0];
-    for (int y = 0; y < getHeight(); y++)
+    if (luminance)
+    {
+        return luminance;
+    }
+    if (comps == 1)
     {
-        for (int x = 0; x < getWidth(); x++)
-        {
-            *m = convertPixel(p);
-            m++;
-            p += 4;
-        }
+        // The image is the luminance matrix itself, so there is nothing to convert.
+        luminance = image;
+        return luminance;
     }
-    return matrix;
+    // The rows follow each other without gaps, so the image is converted in one go.
+    luminance = zxing::ArrayRef<char>(getWidth() * getHeight());
+    convert(reinterpret_cast<const uint8_t*>(&image[0]), reinterpret_cast<uint8_t*>(&luminance[0]), getWidth() * getHeight());
+    return luminance;
+}
+
+bool ImageReaderSource::isCropSupported() const
+{
+    return true;
+}
+
+zxing::Ref<zxing::LuminanceSource> ImageReaderSource::crop(int left, int top, int width, int height) const
+{
+    return getView()->crop(left, top, width, height);
+}
+
+bool ImageReaderSource::isRotateSupported() const
+{
+    return true;
+}
+
+zxing::Ref<zxing::LuminanceSource> ImageReaderSource::rotateCounterClockwise() const
+{
+    return getView()->rotateCounterClockwise();
+}
+
+zxing::Ref<zxing::LuminanceSource> ImageReaderSource::downscale() const
+{
+    return getView()->downscale();
+}
+
+zxing::Ref<LuminanceView> ImageReaderSource::getView() const
+{
+    return zxing::Ref<LuminanceView>(new LuminanceView(getMatrix(), getWidth(), getHeight(), 0, 1, getWidth(), 1));
 }
@@ -18,21 +18,44 @@
 
 #include "zxing/LuminanceSource.h"
 
+#include "GrayConvert.h"
+#include "LuminanceView.h"
+
 // This is a modified version of the ImageReaderSource as provided by ZXing.
 // I've simplified it so it only does what we absolutely need it to do.
 class ImageReaderSource : public zxing::LuminanceSource
 {
 public:
+    /** Create a luminance source for a decoded image.
+     * /param image Pixel data, width * height * comps bytes. The source keeps a reference to it instead of copying it,
+     *              so the image stays alive until the source and everything zxing got from it are gone, and a LuminancePool can re-use it after that.
+     * /param comps Number of bytes per pixel: 1 for luminance (used as is), 3 or 4 for RGB(A).
+     */
     ImageReaderSource(zxing::ArrayRef<char> image, int width, int height, int comps);
 
     zxing::ArrayRef<char> getRow(int y, zxing::ArrayRef<char> row) const;
     zxing::ArrayRef<char> getMatrix() const;
 
+    // Crops, rotations and reduced sizes are LuminanceViews on the luminance matrix, so they don't copy the image.
+    bool isCropSupported() const;
+    zxing::Ref<zxing::LuminanceSource> crop(int left, int top, int width, int height) const;
+    bool isRotateSupported() const;
+    zxing::Ref<zxing::LuminanceSource> rotateCounterClockwise() const;
+
+    /** Get the image at half the size, each pixel is the average of 2x2 pixels. An odd last row or column is left out.
+     */
+    zxing::Ref<zxing::LuminanceSource> downscale() const;
+
 private:
+    // View on the whole luminance matrix.
+    zxing::Ref<LuminanceView> getView() const;
+
     const zxing::ArrayRef<char> image;
     const int comps;
-
-    char convertPixel(const char* pixel) const;
+    // Conversion for the layout of the pixels, picked once for the image.
+    const GrayConvertFunction convert;
+    // The luminance of the image, converted on first use and then shared by getMatrix() and getRow().
+    mutable zxing::ArrayRef<char> luminance;
 };
 
 #endif //IMAGE_READER_SOURCE_H
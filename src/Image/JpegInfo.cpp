@@ -0,0 +1,82 @@
+#include "JpegInfo.h"
+
+// Trailing bytes (like a CRLF) that are allowed after the EOI marker for the frame to be seen as complete.
+static const size_t MAX_TRAILING_BYTES = 16;
+
+JpegInfo::JpegInfo()
+: size(0), width(0), height(0), components(0), progressive(false), complete(false)
+{
+}
+
+bool JpegInfo::parse(const uint8_t* data, size_t data_size)
+{
+    size = data_size;
+    width = 0;
+    height = 0;
+    components = 0;
+    progressive = false;
+    complete = false;
+
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8)
+    {
+        return false;
+    }
+
+    for(size_t n = 0; n < MAX_TRAILING_BYTES && n + 2 <= size; n++)
+    {
+        if (data[size - n - 2] == 0xFF && data[size - n - 1] == 0xD9)
+        {
+            complete = true;
+            break;
+        }
+    }
+
+    size_t pos = 2;
+    while(pos + 4 <= size)
+    {
+        if (data[pos] != 0xFF)
+        {
+            return false;
+        }
+        uint8_t marker = data[pos + 1];
+        pos += 2;
+        if (marker == 0xFF)
+        {
+            // Fill byte, the marker code follows.
+            pos--;
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            // TEM and RSTn have no length.
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA)
+        {
+            // EOI or SOS before the frame header.
+            return false;
+        }
+
+        size_t length = (data[pos] << 8) | data[pos + 1];
+        if (length < 2)
+        {
+            return false;
+        }
+
+        // SOF0-SOF15, except for DHT (0xC4), JPG (0xC8) and DAC (0xCC) which share the range.
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            if (length < 8 || pos + 8 > size)
+            {
+                return false;
+            }
+            height = (data[pos + 3] << 8) | data[pos + 4];
+            width = (data[pos + 5] << 8) | data[pos + 6];
+            components = data[pos + 7];
+            progressive = (marker == 0xC2);
+            return width > 0 && height > 0 && components > 0;
+        }
+        pos += length;
+    }
+    return false;
+}
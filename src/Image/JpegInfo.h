@@ -0,0 +1,33 @@
+#ifndef JPEG_INFO_H
+#define JPEG_INFO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Basic information about a JPEG frame, read from its markers without decoding the image.
+ *  Used to check a received frame before it is handed to the decoder, and to size the buffers for the decoded image.
+ */
+class JpegInfo
+{
+public:
+    JpegInfo();
+
+    /** Read the information from JPEG data, up to the start of frame (SOF) marker.
+     * /param data JPEG data.
+     * /param size Size of the JPEG data in bytes.
+     * /returns true if the data starts a JPEG image and a SOF marker was found.
+     */
+    bool parse(const uint8_t* data, size_t size);
+
+    // Size of the JPEG data in bytes.
+    size_t size;
+    // Image dimensions and number of color components, from the SOF marker.
+    int width;
+    int height;
+    int components;
+    bool progressive;
+    // True if the data ends with an EOI marker, false for truncated frames.
+    bool complete;
+};
+
+#endif //JPEG_INFO_H
@@ -0,0 +1,28 @@
+#include "LuminancePool.h"
+
+zxing::ArrayRef<char> LuminancePool::get(int size)
+{
+    // Only the pool holds a reference to a free matrix.
+    for (zxing::ArrayRef<char>& matrix : matrices)
+    {
+        if (matrix->count() == 1 && matrix->size() == size)
+        {
+            return matrix;
+        }
+    }
+    matrices.push_back(zxing::ArrayRef<char>(size));
+    return matrices.back();
+}
+
+void LuminancePool::trim()
+{
+    std::vector<zxing::ArrayRef<char> > used;
+    for (zxing::ArrayRef<char>& matrix : matrices)
+    {
+        if (matrix->count() > 1)
+        {
+            used.push_back(matrix);
+        }
+    }
+    matrices.swap(used);
+}
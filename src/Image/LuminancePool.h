@@ -0,0 +1,34 @@
+#ifndef LUMINANCE_POOL_H
+#define LUMINANCE_POOL_H
+
+#include <vector>
+
+#include <zxing/common/Array.h>
+
+#include "System/NoCopy.h"
+
+/** Pool of luminance matrices, so decoding a frame does not need to allocate one.
+ *  The matrices are handed out as the zxing::ArrayRef that the ImageReaderSource takes, so zxing uses them without copying.
+ *  A matrix is in use as long as there is a reference to it outside of the pool. When zxing drops the last one, the matrix
+ *  is available again, so a matrix can be kept (for example with a detection in progress) while the next frame is decoded into another one.
+ *  The reference counts of zxing are not thread safe, so a pool and its matrices should only be used from one thread.
+ */
+class LuminancePool : public NoCopy
+{
+public:
+    /** Get a matrix that is not in use.
+     *  A free matrix of the right size is re-used, so in the steady state no allocations are done.
+     * /param size Size of the matrix in bytes: width * height.
+     * /returns matrix of size bytes, with undefined contents.
+     */
+    zxing::ArrayRef<char> get(int size);
+
+    /** Free all matrices that are not in use. Call it when the size of the frames changed, the matrices of the old size are not used again.
+     */
+    void trim();
+
+private:
+    std::vector<zxing::ArrayRef<char> > matrices;
+};
+
+#endif //LUMINANCE_POOL_H
@@ -0,0 +1,117 @@
+#include "LuminanceView.h"
+#include "zxing/common/IllegalArgumentException.h"
+
+#include <cstring>
+
+LuminanceView::LuminanceView(zxing::ArrayRef<char> matrix, int width, int height, int offset, int column_step, int row_step, int scale)
+    : LuminanceSource(width, height), matrix(matrix), offset(offset), column_step(column_step), row_step(row_step), scale(scale) {}
+
+zxing::ArrayRef<char> LuminanceView::getRow(int y, zxing::ArrayRef<char> row) const
+{
+    if (!row)
+    {
+        row = zxing::ArrayRef<char>(getWidth());
+    }
+    if (view_matrix)
+    {
+        memcpy(&row[0], &view_matrix[y * getWidth()], getWidth());
+    } else
+    {
+        fillRow(y, &row[0]);
+    }
+    return row;
+}
+
+zxing::ArrayRef<char> LuminanceView::getMatrix() const
+{
+    // A view that covers the whole matrix as it is, is the matrix.
+    if (offset == 0 && column_step == 1 && row_step == getWidth() && scale == 1 && matrix->size() == getWidth() * getHeight())
+    {
+        return matrix;
+    }
+    if (!view_matrix)
+    {
+        view_matrix = zxing::ArrayRef<char>(getWidth() * getHeight());
+        for (int y = 0; y < getHeight(); y++)
+        {
+            fillRow(y, &view_matrix[y * getWidth()]);
+        }
+    }
+    return view_matrix;
+}
+
+void LuminanceView::fillRow(int y, char* row) const
+{
+    const unsigned char* pixels = reinterpret_cast<const unsigned char*>(&matrix[0]);
+    int start = offset + y * scale * row_step;
+    if (scale == 1)
+    {
+        if (column_step == 1)
+        {
+            memcpy(row, pixels + start, getWidth());
+            return;
+        }
+        for (int x = 0; x < getWidth(); x++)
+        {
+            row[x] = pixels[start + x * column_step];
+        }
+    } else if (scale == 2)
+    {
+        for (int x = 0; x < getWidth(); x++)
+        {
+            const unsigned char* p = pixels + start + x * 2 * column_step;
+            row[x] = (p[0] + p[column_step] + p[row_step] + p[column_step + row_step] + 2) >> 2;
+        }
+    } else
+    {
+        const int count = scale * scale;
+        for (int x = 0; x < getWidth(); x++)
+        {
+            const unsigned char* block = pixels + start + x * scale * column_step;
+            int sum = 0;
+            for (int j = 0; j < scale; j++)
+            {
+                for (int i = 0; i < scale; i++)
+                {
+                    sum += block[j * row_step + i * column_step];
+                }
+            }
+            row[x] = (sum + count / 2) / count;
+        }
+    }
+}
+
+bool LuminanceView::isCropSupported() const
+{
+    return true;
+}
+
+zxing::Ref<zxing::LuminanceSource> LuminanceView::crop(int left, int top, int width, int height) const
+{
+    if (left < 0 || top < 0 || width <= 0 || height <= 0 || left + width > getWidth() || top + height > getHeight())
+    {
+        throw zxing::IllegalArgumentException("Crop rectangle does not fit within image data.");
+    }
+    return zxing::Ref<zxing::LuminanceSource>(new LuminanceView(matrix, width, height, offset + scale * (left * column_step + top * row_step), column_step, row_step, scale));
+}
+
+bool LuminanceView::isRotateSupported() const
+{
+    return true;
+}
+
+zxing::Ref<zxing::LuminanceSource> LuminanceView::rotateCounterClockwise() const
+{
+    // The right column becomes the top row. The start moves to the right column of the matrix pixels the view covers,
+    // so with a scale the blocks stay the same pixels of the matrix.
+    return zxing::Ref<zxing::LuminanceSource>(new LuminanceView(matrix, getHeight(), getWidth(), offset + (scale * getWidth() - 1) * column_step, row_step, -column_step, scale));
+}
+
+zxing::Ref<zxing::LuminanceSource> LuminanceView::downscale() const
+{
+    if (getWidth() < 2 || getHeight() < 2)
+    {
+        throw zxing::IllegalArgumentException("Image too small to downscale.");
+    }
+    return zxing::Ref<zxing::LuminanceSource>(new LuminanceView(matrix, getWidth() / 2, getHeight() / 2, offset, column_step, row_step, scale * 2));
+}
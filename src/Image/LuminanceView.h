@@ -0,0 +1,48 @@
+#ifndef LUMINANCE_VIEW_H
+#define LUMINANCE_VIEW_H
+
+#include "zxing/LuminanceSource.h"
+
+/** Cropped, rotated and/or reduced size view on a luminance matrix, without copying the matrix.
+ *  The pixels of the view are picked out of the shared matrix with a start offset and steps, which can be negative for rotated views.
+ *  With a scale above 1, each pixel of the view is the average of a scale x scale block of the matrix.
+ *  Views are made with ImageReaderSource::crop(), rotateCounterClockwise() and downscale(), and can be cropped, rotated and downscaled again.
+ */
+class LuminanceView : public zxing::LuminanceSource
+{
+public:
+    /** Create a view on a matrix.
+     * /param matrix The luminance matrix, shared with the view.
+     * /param width, height Size of the view in pixels.
+     * /param offset Index in the matrix of the top left pixel of the view. With a scale, of the top left pixel of its block.
+     * /param column_step, row_step Distance in the matrix between horizontally and vertically adjacent pixels of the matrix, as seen in the view.
+     * /param scale Size of the block of the matrix that makes up a pixel of the view.
+     */
+    LuminanceView(zxing::ArrayRef<char> matrix, int width, int height, int offset, int column_step, int row_step, int scale);
+
+    zxing::ArrayRef<char> getRow(int y, zxing::ArrayRef<char> row) const;
+    zxing::ArrayRef<char> getMatrix() const;
+
+    bool isCropSupported() const;
+    zxing::Ref<zxing::LuminanceSource> crop(int left, int top, int width, int height) const;
+    bool isRotateSupported() const;
+    zxing::Ref<zxing::LuminanceSource> rotateCounterClockwise() const;
+
+    /** Get a view of half the size, each pixel is the average of 2x2 pixels of this one. An odd last row or column is left out.
+     */
+    zxing::Ref<zxing::LuminanceSource> downscale() const;
+
+private:
+    // Fill row with the pixels of row y of the view.
+    void fillRow(int y, char* row) const;
+
+    const zxing::ArrayRef<char> matrix;
+    const int offset;
+    const int column_step;
+    const int row_step;
+    const int scale;
+    // The pixels of the view as a matrix of its own, filled when zxing asks for it.
+    mutable zxing::ArrayRef<char> view_matrix;
+};
+
+#endif //LUMINANCE_VIEW_H
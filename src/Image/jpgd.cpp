@@ -10,8 +10,14 @@
 // http://vision.ai.uiuc.edu/~dugad/research/dct/index.html
 
 #include "jpgd.h"
+#include "jpgd_simd.h"
 #include <string.h>
 
+#if defined(JPGD_SIMD_NEON) && !defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
 #include <assert.h>
 #define JPGD_ASSERT(x) assert(x)
 
@@ -21,7 +27,10 @@
 
 // Set to 1 to enable freq. domain chroma upsampling on images using H2V2 subsampling (0=faster nearest neighbor sampling).
 // This is slower, but results in higher quality on images with highly saturated colors.
+// Can be defined by the build, the tests also build jpgd with 0 to cover H2V2Convert().
+#ifndef JPGD_SUPPORT_FREQ_DOMAIN_UPSAMPLING
 #define JPGD_SUPPORT_FREQ_DOMAIN_UPSAMPLING 1
+#endif
 
 #define JPGD_TRUE (1)
 #define JPGD_FALSE (0)
@@ -243,6 +252,52 @@ static const uint8 s_idct_row_table[] =
 
 static const uint8 s_idct_col_table[] = { 1, 1, 2, 3, 3, 3, 3, 3, 3, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8, 8 };
 
+static simd_support detect_simd()
+{
+#if defined(JPGD_SIMD_X86)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return SIMD_SSE2;
+#elif defined(JPGD_SIMD_NEON)
+#if defined(__aarch64__)
+  return SIMD_NEON;
+#else
+  if (getauxval(AT_HWCAP) & HWCAP_NEON)
+    return SIMD_NEON;
+#endif
+#endif
+  return SIMD_NONE;
+}
+
+simd_support get_simd_support()
+{
+  // A local static, so it's also initialized when it's first called from the static initialization of another file.
+  static const simd_support support = detect_simd();
+  return support;
+}
+
+static const simd_support s_simd = get_simd_support();
+
+// The fastest SIMD IDCT the CPU supports, or NULL to use the scalar code below.
+static simd_idct_func select_simd_idct()
+{
+  switch (s_simd)
+  {
+#if defined(JPGD_SIMD_X86)
+    case SIMD_AVX2: return idct_avx2;
+    case SIMD_SSE2: return idct_sse2;
+#endif
+#if defined(JPGD_SIMD_NEON)
+    case SIMD_NEON: return idct_neon;
+#endif
+    default: return NULL;
+  }
+}
+
+static simd_idct_func s_simd_idct = select_simd_idct();
+
 void idct(const jpgd_block_t* pSrc_ptr, uint8* pDst_ptr, int block_max_zag)
 {
   JPGD_ASSERT(block_max_zag >= 1);
@@ -264,6 +319,12 @@ void idct(const jpgd_block_t* pSrc_ptr, uint8* pDst_ptr, int block_max_zag)
     return;
   }
 
+  if (s_simd_idct)
+  {
+    s_simd_idct(pSrc_ptr, pDst_ptr);
+    return;
+  }
+
   int temp[64];
 
   const jpgd_block_t* pSrc = pSrc_ptr;
@@ -334,6 +395,83 @@ void idct_4x4(const jpgd_block_t* pSrc_ptr, uint8* pDst_ptr)
   }
 }
 
+// Reduced size IDCTs, used for scaled decoding (JPGD_FLAG_SCALE_*).
+// An N point IDCT on the N x N lowest frequency coefficients of a block gives an N x N block, which approximates the 8 x 8 block averaged down.
+// The output block is stored with a stride of N.
+
+// c(u) * cos((2x+1)u*pi/8), with c(0) = 1 and c(u) = sqrt(2) otherwise, indexed [x][u].
+static const int32 s_idct_scaled_4_table[4][4] =
+{
+  { 8192,  10703,  8192,   4433 },
+  { 8192,   4433, -8192, -10703 },
+  { 8192,  -4433, -8192,  10703 },
+  { 8192, -10703,  8192,  -4433 }
+};
+
+void idct_scaled_4(const jpgd_block_t* pSrc_ptr, uint8* pDst_ptr)
+{
+  int temp[16];
+
+  for (int v = 0; v < 4; v++)
+  {
+    const jpgd_block_t* pSrc = pSrc_ptr + v * 8;
+    for (int x = 0; x < 4; x++)
+    {
+      const int32* t = s_idct_scaled_4_table[x];
+      temp[v * 4 + x] = DESCALE(t[0] * pSrc[0] + t[1] * pSrc[1] + t[2] * pSrc[2] + t[3] * pSrc[3], CONST_BITS-PASS1_BITS);
+    }
+  }
+
+  for (int y = 0; y < 4; y++)
+  {
+    const int32* t = s_idct_scaled_4_table[y];
+    for (int x = 0; x < 4; x++)
+    {
+      int i = DESCALE_ZEROSHIFT(t[0] * temp[x] + t[1] * temp[4 + x] + t[2] * temp[8 + x] + t[3] * temp[12 + x], CONST_BITS+PASS1_BITS+3);
+      pDst_ptr[y * 4 + x] = (uint8)CLAMP(i);
+    }
+  }
+}
+
+// For 2 points, c(u) * cos((2x+1)u*pi/4) is 1 or -1, so only additions are needed.
+void idct_scaled_2(const jpgd_block_t* pSrc_ptr, uint8* pDst_ptr)
+{
+  int a = pSrc_ptr[0], b = pSrc_ptr[1], c = pSrc_ptr[8], d = pSrc_ptr[9];
+  int i;
+
+  i = ((a + b + c + d + 4) >> 3) + 128;
+  pDst_ptr[0] = (uint8)CLAMP(i);
+  i = ((a - b + c - d + 4) >> 3) + 128;
+  pDst_ptr[1] = (uint8)CLAMP(i);
+  i = ((a + b - c - d + 4) >> 3) + 128;
+  pDst_ptr[2] = (uint8)CLAMP(i);
+  i = ((a - b - c + d + 4) >> 3) + 128;
+  pDst_ptr[3] = (uint8)CLAMP(i);
+}
+
+// IDCT to a block of (8 >> scale_shift) x (8 >> scale_shift) pixels. 1/8 scale, and blocks without AC coefficients, only need the DC coefficient.
+void idct_scaled(const jpgd_block_t* pSrc_ptr, uint8* pDst_ptr, int block_max_zag, int scale_shift)
+{
+  if (scale_shift == 0)
+  {
+    idct(pSrc_ptr, pDst_ptr, block_max_zag);
+    return;
+  }
+
+  if ((block_max_zag <= 1) || (scale_shift == 3))
+  {
+    int k = ((pSrc_ptr[0] + 4) >> 3) + 128;
+    k = CLAMP(k);
+    memset(pDst_ptr, k, 64 >> (scale_shift * 2));
+    return;
+  }
+
+  if (scale_shift == 1)
+    idct_scaled_4(pSrc_ptr, pDst_ptr);
+  else
+    idct_scaled_2(pSrc_ptr, pDst_ptr);
+}
+
 // Retrieve one character from the input stream.
 inline uint jpeg_decoder::get_char()
 {
@@ -514,62 +652,109 @@ inline int jpeg_decoder::huff_decode(huff_tables *pH)
   return symbol;
 }
 
-// Decodes a Huffman encoded symbol.
-inline int jpeg_decoder::huff_decode(huff_tables *pH, int& extra_bits)
+// Tables and macro used to fully decode the DPCM differences.
+static const int s_extend_test[16] = { 0, 0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080, 0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000 };
+static const int s_extend_offset[16] = { 0, ((-1)<<1) + 1, ((-1)<<2) + 1, ((-1)<<3) + 1, ((-1)<<4) + 1, ((-1)<<5) + 1, ((-1)<<6) + 1, ((-1)<<7) + 1, ((-1)<<8) + 1, ((-1)<<9) + 1, ((-1)<<10) + 1, ((-1)<<11) + 1, ((-1)<<12) + 1, ((-1)<<13) + 1, ((-1)<<14) + 1, ((-1)<<15) + 1 };
+static const int s_extend_mask[] = { 0, (1<<0), (1<<1), (1<<2), (1<<3), (1<<4), (1<<5), (1<<6), (1<<7), (1<<8), (1<<9), (1<<10), (1<<11), (1<<12), (1<<13), (1<<14), (1<<15), (1<<16) };
+// The logical AND's in this macro are to shut up static code analysis (aren't really necessary - couldn't find another way to do this)
+#define JPGD_HUFF_EXTEND(x, s) (((x) < s_extend_test[s & 15]) ? ((x) + s_extend_offset[s & 15]) : (x))
+
+// Continues in the 64-bit bit buffer where the 32-bit one is. Called whenever the 32-bit bit buffer was restarted for a scan or restart interval.
+void jpeg_decoder::sync_bit_buf64()
 {
-  int symbol;
+  m_bit_count64 = m_bits_left + 16;
+  m_bit_buf64 = (static_cast<uint64>(m_bit_buf) << 32) & ~(~static_cast<uint64>(0) >> m_bit_count64);
+}
 
-  // Check first 8-bits: do we have a complete symbol?
-  if ((symbol = pH->look_up2[m_bit_buf >> 24]) < 0)
+// Fills the 64-bit bit buffer with at least 56 bits. Like get_bits_no_markers(), it returns an infinite number of 1's at a marker.
+inline void jpeg_decoder::fill_bit_buf64()
+{
+  if (m_in_buf_left >= 8)
   {
-    // Use a tree traversal to find symbol.
-    int ofs = 23;
-    do
+    const uint8 *p = m_pIn_buf_ofs;
+    uint64 c = 0;
+    for (int i = 0; i < 8; i++)
+      c = (c << 8) | p[i];
+
+    // Without a 0xFF in the next 8 bytes there are no stuffed bytes or markers, so as many bytes as fit can be taken at once.
+    if (((~c - 0x0101010101010101ULL) & c & 0x8080808080808080ULL) == 0)
     {
-      symbol = pH->tree[-(int)(symbol + ((m_bit_buf >> ofs) & 1))];
-      ofs--;
-    } while (symbol < 0);
+      const int num_bytes = (63 - m_bit_count64) >> 3;
+      m_bit_buf64 |= (c >> (64 - num_bytes * 8)) << (64 - num_bytes * 8 - m_bit_count64);
+      m_bit_count64 += num_bytes * 8;
+      m_pIn_buf_ofs += num_bytes;
+      m_in_buf_left -= num_bytes;
+      return;
+    }
+  }
 
-    get_bits_no_markers(8 + (23 - ofs));
+  do
+  {
+    m_bit_buf64 |= static_cast<uint64>(get_octet()) << (56 - m_bit_count64);
+    m_bit_count64 += 8;
+  } while (m_bit_count64 <= 56);
+}
 
-    extra_bits = get_bits_no_markers(symbol & 0xF);
-  }
-  else
+// Decodes a Huffman encoded symbol and its extra bits from the 64-bit bit buffer. value is set to the sign extended extra bits.
+inline int jpeg_decoder::huff_decode_fast(huff_tables *pH, int& value)
+{
+  // A code and its extra bits take at most 16 + 15 bits.
+  if (m_bit_count64 < 32)
+    fill_bit_buf64();
+
+  int symbol;
+  int num_bits;
+  const int entry = pH->look_up_fast[m_bit_buf64 >> (64 - JPGD_HUFF_FAST_BITS)];
+  if (entry)
   {
-    JPGD_ASSERT(((symbol >> 8) & 31) == pH->code_size[symbol & 255] + ((symbol & 0x8000) ? (symbol & 15) : 0));
+    num_bits = (entry >> 8) & 31;
+    m_bit_buf64 <<= num_bits;
+    m_bit_count64 -= num_bits;
 
-    if (symbol & 0x8000)
+    if (entry & 0x2000)
     {
-      get_bits_no_markers((symbol >> 8) & 31);
-      extra_bits = symbol >> 16;
+      value = entry >> 16;
+      return entry & 0xFF;
     }
-    else
+
+    symbol = entry & 0xFF;
+  }
+  else
+  {
+    // Longer code, use a tree traversal like huff_decode() does.
+    const uint bits = static_cast<uint>(m_bit_buf64 >> 32);
+    if ((symbol = pH->look_up[bits >> 24]) < 0)
     {
-      int code_size = (symbol >> 8) & 31;
-      int num_extra_bits = symbol & 0xF;
-      int bits = code_size + num_extra_bits;
-      if (bits <= (m_bits_left + 16))
-        extra_bits = get_bits_no_markers(bits) & ((1 << num_extra_bits) - 1);
-      else
+      int ofs = 23;
+      do
       {
-        get_bits_no_markers(code_size);
-        extra_bits = get_bits_no_markers(num_extra_bits);
-      }
+        symbol = pH->tree[-(int)(symbol + ((bits >> ofs) & 1))];
+        ofs--;
+      } while (symbol < 0);
+
+      num_bits = 8 + (23 - ofs);
     }
+    else
+      num_bits = pH->code_size[symbol];
 
-    symbol &= 0xFF;
+    m_bit_buf64 <<= num_bits;
+    m_bit_count64 -= num_bits;
   }
 
+  const int num_extra_bits = symbol & 15;
+  if (num_extra_bits)
+  {
+    const int extra_bits = static_cast<int>(m_bit_buf64 >> (64 - num_extra_bits));
+    m_bit_buf64 <<= num_extra_bits;
+    m_bit_count64 -= num_extra_bits;
+    value = JPGD_HUFF_EXTEND(extra_bits, num_extra_bits);
+  }
+  else
+    value = 0;
+
   return symbol;
 }
 
-// Tables and macro used to fully decode the DPCM differences.
-static const int s_extend_test[16] = { 0, 0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080, 0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000 };
-static const int s_extend_offset[16] = { 0, ((-1)<<1) + 1, ((-1)<<2) + 1, ((-1)<<3) + 1, ((-1)<<4) + 1, ((-1)<<5) + 1, ((-1)<<6) + 1, ((-1)<<7) + 1, ((-1)<<8) + 1, ((-1)<<9) + 1, ((-1)<<10) + 1, ((-1)<<11) + 1, ((-1)<<12) + 1, ((-1)<<13) + 1, ((-1)<<14) + 1, ((-1)<<15) + 1 };
-static const int s_extend_mask[] = { 0, (1<<0), (1<<1), (1<<2), (1<<3), (1<<4), (1<<5), (1<<6), (1<<7), (1<<8), (1<<9), (1<<10), (1<<11), (1<<12), (1<<13), (1<<14), (1<<15), (1<<16) };
-// The logical AND's in this macro are to shut up static code analysis (aren't really necessary - couldn't find another way to do this)
-#define JPGD_HUFF_EXTEND(x, s) (((x) < s_extend_test[s & 15]) ? ((x) + s_extend_offset[s & 15]) : (x))
-
 // Clamps a value between 0-255.
 inline uint8 jpeg_decoder::clamp(int i)
 {
@@ -843,29 +1028,46 @@ namespace DCT_Upsample
 void jpeg_decoder::free_all_blocks()
 {
   m_pStream = NULL;
-  for (mem_block *b = m_pMem_blocks; b; )
+  mem_block *lists[2] = { m_pMem_blocks, m_pTable_mem_blocks };
+  for (int i = 0; i < 2; i++)
   {
-    mem_block *n = b->m_pNext;
-    jpgd_free(b);
-    b = n;
+    for (mem_block *b = lists[i]; b; )
+    {
+      mem_block *n = b->m_pNext;
+      jpgd_free(b);
+      b = n;
+    }
   }
   m_pMem_blocks = NULL;
+  m_pTable_mem_blocks = NULL;
+}
+
+// Marks all memory for the image as unused, without freeing it. The same allocations for the next image will then use the same memory.
+void jpeg_decoder::rewind_all_blocks()
+{
+  for (mem_block *b = m_pMem_blocks; b; b = b->m_pNext)
+    b->m_used_count = 0;
 }
 
 // This method handles all errors. It will never return.
 // It could easily be changed to use C++ exceptions.
+// The memory is kept, so the decoder can be reset() for the next image. The destructor frees it.
 JPGD_NORETURN void jpeg_decoder::stop_decoding(jpgd_status status)
 {
   m_error_code = status;
-  free_all_blocks();
   longjmp(m_jmp_state, status);
 }
 
 void *jpeg_decoder::alloc(size_t nSize, bool zero)
+{
+  return alloc_from(&m_pMem_blocks, nSize, zero);
+}
+
+void *jpeg_decoder::alloc_from(mem_block **ppBlocks, size_t nSize, bool zero)
 {
   nSize = (JPGD_MAX(nSize, 1) + 3) & ~3;
   char *rv = NULL;
-  for (mem_block *b = m_pMem_blocks; b; b = b->m_pNext)
+  for (mem_block *b = *ppBlocks; b; b = b->m_pNext)
   {
     if ((b->m_used_count + nSize) <= b->m_size)
     {
@@ -879,7 +1081,7 @@ void *jpeg_decoder::alloc(size_t nSize, bool zero)
     int capacity = JPGD_MAX(32768 - 256, (nSize + 2047) & ~2047);
     mem_block *b = (mem_block*)jpgd_malloc(sizeof(mem_block) + capacity);
     if (!b) { stop_decoding(JPGD_NOTENOUGHMEM); }
-    b->m_pNext = m_pMem_blocks; m_pMem_blocks = b;
+    b->m_pNext = *ppBlocks; *ppBlocks = b;
     b->m_used_count = nSize;
     b->m_size = capacity;
     rv = b->m_data;
@@ -910,6 +1112,22 @@ void jpeg_decoder::prep_in_buffer()
   if (m_eof_flag)
     return;
 
+  // Read the whole stream in place if it's already in memory.
+  int in_place_size = 0;
+  uint8 *pIn_place = m_pStream->get_in_place_buffer(&in_place_size);
+  if (pIn_place)
+  {
+    m_pIn_place_data = pIn_place;
+    m_in_place_size = in_place_size;
+    m_pIn_buf_ofs = pIn_place;
+    m_in_buf_left = in_place_size;
+    m_eof_flag = true;
+    m_total_bytes_read += m_in_buf_left;
+    word_clear(m_pIn_buf_ofs + m_in_buf_left, 0xD9FF, JPGD_IN_PLACE_PAD_SIZE / 2);
+    return;
+  }
+
+  // Start on whatever the stream has, it may still be receiving the rest.
   do
   {
     int bytes_read = m_pStream->read(m_in_buf + m_in_buf_left, JPGD_IN_BUF_SIZE - m_in_buf_left, &m_eof_flag);
@@ -917,7 +1135,7 @@ void jpeg_decoder::prep_in_buffer()
       stop_decoding(JPGD_STREAM_READ);
 
     m_in_buf_left += bytes_read;
-  } while ((m_in_buf_left < JPGD_IN_BUF_SIZE) && (!m_eof_flag));
+  } while ((!m_in_buf_left) && (!m_eof_flag));
 
   m_total_bytes_read += m_in_buf_left;
 
@@ -976,12 +1194,17 @@ void jpeg_decoder::read_dht_marker()
       stop_decoding(JPGD_BAD_DHT_INDEX);
 
     if (!m_huff_num[index])
-      m_huff_num[index] = (uint8 *)alloc(17);
-
-    if (!m_huff_val[index])
-      m_huff_val[index] = (uint8 *)alloc(256);
+    {
+      m_huff_num[index] = (uint8 *)alloc_from(&m_pTable_mem_blocks, 17);
+      m_huff_val[index] = (uint8 *)alloc_from(&m_pTable_mem_blocks, 256);
+      m_huff_dirty[index] = true;
+    }
+    // A camera sends the same tables with every frame, the decoding tables only need to be built again when they are different.
+    else if ((memcmp(m_huff_num[index], huff_num, 17) != 0) || (memcmp(m_huff_val[index], huff_val, count) != 0))
+      m_huff_dirty[index] = true;
 
     m_huff_ac[index] = (index & 0x10) != 0;
+    m_huff_defined[index] = true;
     memcpy(m_huff_num[index], huff_num, 17);
     memcpy(m_huff_val[index], huff_val, 256);
   }
@@ -1354,18 +1577,29 @@ int jpeg_decoder::locate_sos_marker()
 }
 
 // Reset everything to default/uninitialized state.
-void jpeg_decoder::init(jpeg_decoder_stream *pStream)
-{
-  m_pMem_blocks = NULL;
+void jpeg_decoder::init(jpeg_decoder_stream *pStream, uint flags)
+{
+  m_flags = flags;
+  m_scale_shift = 0;
+  if (m_flags & JPGD_FLAG_SCALE_1_8)
+    m_scale_shift = 3;
+  else if (m_flags & JPGD_FLAG_SCALE_1_4)
+    m_scale_shift = 2;
+  else if (m_flags & JPGD_FLAG_SCALE_1_2)
+    m_scale_shift = 1;
+  // Scaled decoding is only implemented for the luma.
+  if (m_scale_shift)
+    m_flags |= JPGD_FLAG_LUMA_ONLY;
+
+  rewind_all_blocks();
   m_error_code = JPGD_SUCCESS;
   m_ready_flag = false;
   m_image_x_size = m_image_y_size = 0;
   m_pStream = pStream;
   m_progressive_flag = JPGD_FALSE;
 
-  memset(m_huff_ac, 0, sizeof(m_huff_ac));
-  memset(m_huff_num, 0, sizeof(m_huff_num));
-  memset(m_huff_val, 0, sizeof(m_huff_val));
+  // The Huffman tables are kept for reset(), but the stream has to define them again before they can be used.
+  memset(m_huff_defined, 0, sizeof(m_huff_defined));
   memset(m_quant, 0, sizeof(m_quant));
 
   m_scan_type = 0;
@@ -1406,8 +1640,6 @@ void jpeg_decoder::init(jpeg_decoder_stream *pStream)
   m_dest_bytes_per_scan_line = 0;
   m_dest_bytes_per_pixel = 0;
 
-  memset(m_pHuff_tabs, 0, sizeof(m_pHuff_tabs));
-
   memset(m_dc_coeffs, 0, sizeof(m_dc_coeffs));
   memset(m_ac_coeffs, 0, sizeof(m_ac_coeffs));
   memset(m_block_y_mcu, 0, sizeof(m_block_y_mcu));
@@ -1442,12 +1674,32 @@ void jpeg_decoder::init(jpeg_decoder_stream *pStream)
   m_pScan_line_0 = NULL;
   m_pScan_line_1 = NULL;
 
+  m_pIn_place_data = NULL;
+  m_in_place_size = 0;
+  m_pScan_data = NULL;
+  m_num_workers = 0;
+  m_pInterval_data = NULL;
+  m_parallel_first_mcu = 0;
+  m_parallel_end_mcu = 0;
+  m_pParallel_sample_buf = NULL;
+  m_parallel_row_size = 0;
+  m_parallel_row = 0;
+
+  m_crop_x = m_crop_y = m_crop_width = m_crop_height = 0;
+  m_crop_mcu_x_begin = m_crop_mcu_x_end = m_crop_mcus_per_row = 0;
+  m_crop_mcu_rows_to_skip = 0;
+  m_crop_lines_to_skip = 0;
+  m_crop_line_ofs = 0;
+  m_pCrop_sample_buf = NULL;
+
   // Ready the input buffer.
   prep_in_buffer();
 
   // Prime the bit buffer.
   m_bits_left = 16;
   m_bit_buf = 0;
+  m_bit_buf64 = 0;
+  m_bit_count64 = 0;
 
   get_bits(16);
   get_bits(16);
@@ -1460,6 +1712,48 @@ void jpeg_decoder::init(jpeg_decoder_stream *pStream)
 #define ONE_HALF  ((int) 1 << (SCALEBITS-1))
 #define FIX(x)    ((int) ((x) * (1L<<SCALEBITS) + 0.5f))
 
+// The SIMD colour converters the CPU supports, or NULL to use the lookup tables.
+// There are no AVX2 versions, a line is too short for them to gain anything over SSE2.
+static simd_ycc_h1_func select_simd_ycc_h1()
+{
+  switch (s_simd)
+  {
+#if defined(JPGD_SIMD_X86)
+    case SIMD_AVX2:
+    case SIMD_SSE2: return ycc_rgb_h1_sse2;
+#endif
+#if defined(JPGD_SIMD_NEON)
+    case SIMD_NEON: return ycc_rgb_h1_neon;
+#endif
+    default: return NULL;
+  }
+}
+
+static simd_ycc_h2_func select_simd_ycc_h2()
+{
+  switch (s_simd)
+  {
+#if defined(JPGD_SIMD_X86)
+    case SIMD_AVX2:
+    case SIMD_SSE2: return ycc_rgb_h2_sse2;
+#endif
+#if defined(JPGD_SIMD_NEON)
+    case SIMD_NEON: return ycc_rgb_h2_neon;
+#endif
+    default: return NULL;
+  }
+}
+
+static simd_ycc_h1_func s_simd_ycc_h1 = select_simd_ycc_h1();
+static simd_ycc_h2_func s_simd_ycc_h2 = select_simd_ycc_h2();
+
+void set_simd_enabled(bool enabled)
+{
+  s_simd_idct = enabled ? select_simd_idct() : NULL;
+  s_simd_ycc_h1 = enabled ? select_simd_ycc_h1() : NULL;
+  s_simd_ycc_h2 = enabled ? select_simd_ycc_h2() : NULL;
+}
+
 // Create a few tables that allow us to quickly convert YCbCr to RGB.
 void jpeg_decoder::create_look_ups()
 {
@@ -1489,9 +1783,12 @@ void jpeg_decoder::fix_in_buffer()
   stuff_char((uint8)((m_bit_buf >> 16) & 0xFF));
   stuff_char((uint8)((m_bit_buf >> 24) & 0xFF));
 
+  m_pScan_data = m_pIn_buf_ofs;
+
   m_bits_left = 16;
   get_bits_no_markers(16);
   get_bits_no_markers(16);
+  sync_bit_buf64();
 }
 
 void jpeg_decoder::transform_mcu(int mcu_row)
@@ -1499,6 +1796,19 @@ void jpeg_decoder::transform_mcu(int mcu_row)
   jpgd_block_t* pSrc_ptr = m_pMCU_coefficients;
   uint8* pDst_ptr = m_pSample_buf + mcu_row * m_blocks_per_mcu * 64;
 
+  if (m_flags & JPGD_FLAG_LUMA_ONLY)
+  {
+    // The chroma blocks were not decoded, leave their part of the sample buffer alone.
+    for (int mcu_block = 0; mcu_block < m_blocks_per_mcu; mcu_block++)
+    {
+      if (m_mcu_org[mcu_block] == 0)
+        idct_scaled(pSrc_ptr, pDst_ptr, m_mcu_block_max_zag[mcu_block], m_scale_shift);
+      pSrc_ptr += 64;
+      pDst_ptr += 64;
+    }
+    return;
+  }
+
   for (int mcu_block = 0; mcu_block < m_blocks_per_mcu; mcu_block++)
   {
     idct(pSrc_ptr, pDst_ptr, m_mcu_block_max_zag[mcu_block]);
@@ -1652,24 +1962,29 @@ void jpeg_decoder::load_next_row()
     for (mcu_block = 0; mcu_block < m_blocks_per_mcu; mcu_block++)
     {
       component_id = m_mcu_org[mcu_block];
-      q = m_quant[m_comp_quant[component_id]];
 
-      p = m_pMCU_coefficients + 64 * mcu_block;
+      // The chroma coefficients are not needed when only decoding luma.
+      if (!(m_flags & JPGD_FLAG_LUMA_ONLY) || (component_id == 0))
+      {
+        q = m_quant[m_comp_quant[component_id]];
 
-      jpgd_block_t* pAC = coeff_buf_getp(m_ac_coeffs[component_id], block_x_mcu[component_id] + block_x_mcu_ofs, m_block_y_mcu[component_id] + block_y_mcu_ofs);
-      jpgd_block_t* pDC = coeff_buf_getp(m_dc_coeffs[component_id], block_x_mcu[component_id] + block_x_mcu_ofs, m_block_y_mcu[component_id] + block_y_mcu_ofs);
-      p[0] = pDC[0];
-      memcpy(&p[1], &pAC[1], 63 * sizeof(jpgd_block_t));
+        p = m_pMCU_coefficients + 64 * mcu_block;
 
-      for (i = 63; i > 0; i--)
-        if (p[g_ZAG[i]])
-          break;
+        jpgd_block_t* pAC = coeff_buf_getp(m_ac_coeffs[component_id], block_x_mcu[component_id] + block_x_mcu_ofs, m_block_y_mcu[component_id] + block_y_mcu_ofs);
+        jpgd_block_t* pDC = coeff_buf_getp(m_dc_coeffs[component_id], block_x_mcu[component_id] + block_x_mcu_ofs, m_block_y_mcu[component_id] + block_y_mcu_ofs);
+        p[0] = pDC[0];
+        memcpy(&p[1], &pAC[1], 63 * sizeof(jpgd_block_t));
 
-      m_mcu_block_max_zag[mcu_block] = i + 1;
+        for (i = 63; i > 0; i--)
+          if (p[g_ZAG[i]])
+            break;
+
+        m_mcu_block_max_zag[mcu_block] = i + 1;
 
-      for ( ; i >= 0; i--)
-				if (p[g_ZAG[i]])
-					p[g_ZAG[i]] = static_cast<jpgd_block_t>(p[g_ZAG[i]] * q[i]);
+        for ( ; i >= 0; i--)
+          if (p[g_ZAG[i]])
+            p[g_ZAG[i]] = static_cast<jpgd_block_t>(p[g_ZAG[i]] * q[i]);
+      }
 
       row_block++;
 
@@ -1691,10 +2006,14 @@ void jpeg_decoder::load_next_row()
       }
     }
 
-    if (m_freq_domain_chroma_upsample)
-      transform_mcu_expand(mcu_row);
-    else
-      transform_mcu(mcu_row);
+    // Only the MCUs in the crop rectangle are transformed.
+    if ((!m_crop_mcu_rows_to_skip) && (mcu_row >= m_crop_mcu_x_begin) && (mcu_row < m_crop_mcu_x_end))
+    {
+      if (m_freq_domain_chroma_upsample)
+        transform_mcu_expand(mcu_row);
+      else
+        transform_mcu(mcu_row);
+    }
   }
 
   if (m_comps_in_scan == 1)
@@ -1754,115 +2073,296 @@ void jpeg_decoder::process_restart()
   m_bits_left = 16;
   get_bits_no_markers(16);
   get_bits_no_markers(16);
+  sync_bit_buf64();
 }
 
 static inline int dequantize_ac(int c, int q) {	c *= q;	return c; }
 
-// Decodes and dequantizes the next row of coefficients.
-void jpeg_decoder::decode_next_row()
+// Decodes and dequantizes the coefficients of the next MCU.
+void jpeg_decoder::decode_mcu()
 {
-  int row_block = 0;
-
-  for (int mcu_row = 0; mcu_row < m_mcus_per_row; mcu_row++)
+  jpgd_block_t* p = m_pMCU_coefficients;
+  for (int mcu_block = 0; mcu_block < m_blocks_per_mcu; mcu_block++, p += 64)
   {
-    if ((m_restart_interval) && (m_restarts_left == 0))
-      process_restart();
+    int component_id = m_mcu_org[mcu_block];
 
-    jpgd_block_t* p = m_pMCU_coefficients;
-    for (int mcu_block = 0; mcu_block < m_blocks_per_mcu; mcu_block++, p += 64)
+    if ((m_flags & JPGD_FLAG_LUMA_ONLY) && (component_id != 0))
     {
-      int component_id = m_mcu_org[mcu_block];
-      jpgd_quant_t* q = m_quant[m_comp_quant[component_id]];
+      skip_block(component_id);
+      continue;
+    }
 
-      int r, s;
-      s = huff_decode(m_pHuff_tabs[m_comp_dc_tab[component_id]], r);
-      s = JPGD_HUFF_EXTEND(r, s);
+    jpgd_quant_t* q = m_quant[m_comp_quant[component_id]];
 
-      m_last_dc_val[component_id] = (s += m_last_dc_val[component_id]);
+    int r, s;
+    huff_decode_fast(m_pHuff_tabs[m_comp_dc_tab[component_id]], s);
 
-      p[0] = static_cast<jpgd_block_t>(s * q[0]);
+    m_last_dc_val[component_id] = (s += m_last_dc_val[component_id]);
 
-      int prev_num_set = m_mcu_block_max_zag[mcu_block];
+    p[0] = static_cast<jpgd_block_t>(s * q[0]);
 
-      huff_tables *pH = m_pHuff_tabs[m_comp_ac_tab[component_id]];
+    int prev_num_set = m_mcu_block_max_zag[mcu_block];
 
-      int k;
-      for (k = 1; k < 64; k++)
-      {
-        int extra_bits;
-        s = huff_decode(pH, extra_bits);
+    huff_tables *pH = m_pHuff_tabs[m_comp_ac_tab[component_id]];
 
-        r = s >> 4;
-        s &= 15;
+    int k;
+    for (k = 1; k < 64; k++)
+    {
+      int value;
+      s = huff_decode_fast(pH, value);
 
-        if (s)
-        {
-          if (r)
-          {
-            if ((k + r) > 63)
-              stop_decoding(JPGD_DECODE_ERROR);
+      r = s >> 4;
+      s &= 15;
 
-            if (k < prev_num_set)
-            {
-              int n = JPGD_MIN(r, prev_num_set - k);
-              int kt = k;
-              while (n--)
-                p[g_ZAG[kt++]] = 0;
-            }
+      if (s)
+      {
+        if (r)
+        {
+          if ((k + r) > 63)
+            stop_decoding(JPGD_DECODE_ERROR);
 
-            k += r;
+          if (k < prev_num_set)
+          {
+            int n = JPGD_MIN(r, prev_num_set - k);
+            int kt = k;
+            while (n--)
+              p[g_ZAG[kt++]] = 0;
           }
-          
-          s = JPGD_HUFF_EXTEND(extra_bits, s);
-
-          JPGD_ASSERT(k < 64);
 
-          p[g_ZAG[k]] = static_cast<jpgd_block_t>(dequantize_ac(s, q[k])); //s * q[k];
+          k += r;
         }
-        else
+
+        JPGD_ASSERT(k < 64);
+
+        p[g_ZAG[k]] = static_cast<jpgd_block_t>(dequantize_ac(value, q[k])); //value * q[k];
+      }
+      else
+      {
+        if (r == 15)
         {
-          if (r == 15)
-          {
-            if ((k + 16) > 64)
-              stop_decoding(JPGD_DECODE_ERROR);
+          if ((k + 16) > 64)
+            stop_decoding(JPGD_DECODE_ERROR);
 
-            if (k < prev_num_set)
+          if (k < prev_num_set)
+          {
+            int n = JPGD_MIN(16, prev_num_set - k);
+            int kt = k;
+            while (n--)
             {
-              int n = JPGD_MIN(16, prev_num_set - k);
-              int kt = k;
-              while (n--)
-              {
-                JPGD_ASSERT(kt <= 63);
-                p[g_ZAG[kt++]] = 0;
-              }
+              JPGD_ASSERT(kt <= 63);
+              p[g_ZAG[kt++]] = 0;
             }
-
-            k += 16 - 1; // - 1 because the loop counter is k
-            JPGD_ASSERT(p[g_ZAG[k]] == 0);
           }
-          else
-            break;
+
+          k += 16 - 1; // - 1 because the loop counter is k
+          JPGD_ASSERT(p[g_ZAG[k]] == 0);
         }
+        else
+          break;
       }
+    }
 
-      if (k < prev_num_set)
+    if (k < prev_num_set)
+    {
+      int kt = k;
+      while (kt < prev_num_set)
+        p[g_ZAG[kt++]] = 0;
+    }
+
+    m_mcu_block_max_zag[mcu_block] = k;
+  }
+}
+
+// Decodes and dequantizes the next row of coefficients.
+void jpeg_decoder::decode_next_row()
+{
+  for (int mcu_row = 0; mcu_row < m_mcus_per_row; mcu_row++)
+  {
+    if ((m_restart_interval) && (m_restarts_left == 0))
+      process_restart();
+
+    decode_mcu();
+
+    // Only the MCUs in the crop rectangle are transformed.
+    if ((!m_crop_mcu_rows_to_skip) && (mcu_row >= m_crop_mcu_x_begin) && (mcu_row < m_crop_mcu_x_end))
+    {
+      if (m_freq_domain_chroma_upsample)
+        transform_mcu_expand(mcu_row);
+      else
+        transform_mcu(mcu_row);
+    }
+
+    m_restarts_left--;
+  }
+}
+
+// Decodes the scan on the threads of the executor, if it is split into restart intervals. Each thread has its own decoder (a worker),
+// which decodes a range of intervals from the in place stream data, and transforms the MCUs into m_pParallel_sample_buf.
+// Returns false, without changing the state of the decoder, when the image can not be decoded this way.
+bool jpeg_decoder::decode_parallel()
+{
+  if ((!m_pExecutor) || (!m_restart_interval) || (m_progressive_flag) || (!m_pIn_place_data) || (m_comps_in_scan != m_comps_in_frame))
+    return false;
+
+  const int total_mcus = m_mcus_per_row * m_max_mcus_per_col;
+  const int num_intervals = (total_mcus + m_restart_interval - 1) / m_restart_interval;
+
+  // Find the start of each interval. In entropy coded data 0xFF is always followed by 0x00, any other byte after it is a marker.
+  // The intervals must be followed by the restart markers in order, and the last one by EOI, anything else is left to the sequential decoder to deal with.
+  const uint8 *pEnd = m_pIn_place_data + m_in_place_size;
+  const uint8 *p = m_pScan_data;
+  m_pInterval_data = (const uint8 **)alloc(num_intervals * sizeof(uint8 *));
+  m_pInterval_data[0] = p;
+  int n = 1;
+  for ( ; ; )
+  {
+    p = (const uint8 *)memchr(p, 0xFF, pEnd - p);
+    if ((!p) || (p + 1 >= pEnd))
+      return false;
+
+    const int c = p[1];
+    if ((c == 0x00) || (c == 0xFF))
+      p++;
+    else if ((c >= M_RST0) && (c <= M_RST7))
+    {
+      if ((n == num_intervals) || (c != M_RST0 + ((n - 1) & 7)))
+        return false;
+      p += 2;
+      m_pInterval_data[n++] = p;
+    }
+    else if ((c == M_EOI) && (n == num_intervals))
+      break;
+    else
+      return false;
+  }
+
+  // Only the MCU rows down to the bottom of the crop rectangle are decoded, and only the intervals that overlap them.
+  const int mcu_y_size = m_max_mcu_y_size >> m_scale_shift;
+  const int num_rows = (m_total_lines_left + mcu_y_size - 1) / mcu_y_size;
+  m_parallel_first_mcu = m_crop_mcu_rows_to_skip * m_mcus_per_row;
+  m_parallel_end_mcu = JPGD_MIN(m_parallel_first_mcu + num_rows * m_mcus_per_row, total_mcus);
+  const int first_interval = m_parallel_first_mcu / m_restart_interval;
+  const int end_interval = (m_parallel_end_mcu + m_restart_interval - 1) / m_restart_interval;
+
+  m_parallel_row_size = (m_freq_domain_chroma_upsample ? m_expanded_blocks_per_row : m_max_blocks_per_row) * 64;
+  m_pParallel_sample_buf = (uint8 *)alloc(num_rows * m_parallel_row_size);
+
+  // The workers parse the headers of the same stream, with the same settings. This is done here, as it writes the padding after the in place data.
+  m_num_workers = JPGD_MIN(JPGD_MIN(m_pExecutor->get_num_threads(), (int)JPGD_MAX_THREADS), end_interval - first_interval);
+  for (int i = 0; i < m_num_workers; i++)
+  {
+    m_worker_streams[i].open_in_place(m_pIn_place_data, m_in_place_size);
+    if (!m_pWorkers[i])
+    {
+      m_pWorkers[i] = new jpeg_decoder(&m_worker_streams[i], m_flags);
+    }
+    else
+      m_pWorkers[i]->reset(&m_worker_streams[i], m_flags);
+
+    jpeg_decoder *pWorker = m_pWorkers[i];
+    pWorker->m_crop_x = m_crop_x;
+    pWorker->m_crop_y = m_crop_y;
+    pWorker->m_crop_width = m_crop_width;
+    pWorker->m_crop_height = m_crop_height;
+    if (pWorker->begin_decoding() != JPGD_SUCCESS)
+      stop_decoding(pWorker->get_error_code());
+  }
+
+  m_pExecutor->run(decode_intervals_task, this, m_num_workers);
+
+  for (int i = 0; i < m_num_workers; i++)
+    if (m_pWorkers[i]->get_error_code() != JPGD_SUCCESS)
+      stop_decoding(m_pWorkers[i]->get_error_code());
+
+  m_crop_mcu_rows_to_skip = 0;
+  m_parallel_row = 0;
+  m_total_bytes_read -= static_cast<int>(pEnd - (p + 2));
+  return true;
+}
+
+void jpeg_decoder::decode_intervals_task(void *pData, int index)
+{
+  jpeg_decoder *pMain = static_cast<jpeg_decoder *>(pData);
+
+  const int first_interval = pMain->m_parallel_first_mcu / pMain->m_restart_interval;
+  const int end_interval = (pMain->m_parallel_end_mcu + pMain->m_restart_interval - 1) / pMain->m_restart_interval;
+  const int count = end_interval - first_interval;
+
+  pMain->m_pWorkers[index]->decode_intervals(pMain, first_interval + count * index / pMain->m_num_workers, first_interval + count * (index + 1) / pMain->m_num_workers);
+}
+
+// Worker side of decode_parallel(). Errors are left in m_error_code.
+void jpeg_decoder::decode_intervals(const jpeg_decoder *pMain, int first_interval, int end_interval)
+{
+  if (setjmp(m_jmp_state))
+    return;
+
+  for (int interval = first_interval; interval < end_interval; interval++)
+  {
+    // Start the bit buffer at the interval, like process_restart() does after the marker.
+    m_pIn_buf_ofs = const_cast<uint8 *>(pMain->m_pInterval_data[interval]);
+    m_in_buf_left = static_cast<int>(m_pIn_place_data + m_in_place_size - m_pIn_buf_ofs);
+    m_tem_flag = 0;
+    memset(&m_last_dc_val, 0, m_comps_in_frame * sizeof(uint));
+    m_eob_run = 0;
+    m_bits_left = 16;
+    get_bits_no_markers(16);
+    get_bits_no_markers(16);
+    sync_bit_buf64();
+
+    int mcu = interval * m_restart_interval;
+    const int end_mcu = JPGD_MIN(mcu + m_restart_interval, pMain->m_parallel_end_mcu);
+    for ( ; mcu < end_mcu; mcu++)
+    {
+      decode_mcu();
+
+      const int mcu_col = mcu % m_mcus_per_row;
+      if ((mcu >= pMain->m_parallel_first_mcu) && (mcu_col >= m_crop_mcu_x_begin) && (mcu_col < m_crop_mcu_x_end))
       {
-        int kt = k;
-        while (kt < prev_num_set)
-          p[g_ZAG[kt++]] = 0;
+        // The transforms write into m_pSample_buf, point it at the row of this MCU.
+        m_pSample_buf = pMain->m_pParallel_sample_buf + ((mcu - pMain->m_parallel_first_mcu) / m_mcus_per_row) * pMain->m_parallel_row_size;
+        if (m_freq_domain_chroma_upsample)
+          transform_mcu_expand(mcu_col);
+        else
+          transform_mcu(mcu_col);
       }
+    }
+  }
+}
 
-      m_mcu_block_max_zag[mcu_block] = k;
+// Reads the Huffman codes of a block without storing its coefficients. Used for the chroma blocks when only decoding luma:
+// the codes have to be read to find the start of the next block, but the values themselves are not needed.
+void jpeg_decoder::skip_block(int component_id)
+{
+  int r, s;
+  huff_decode_fast(m_pHuff_tabs[m_comp_dc_tab[component_id]], r);
 
-      row_block++;
-    }
+  huff_tables *pH = m_pHuff_tabs[m_comp_ac_tab[component_id]];
+
+  for (int k = 1; k < 64; k++)
+  {
+    s = huff_decode_fast(pH, r);
+
+    r = s >> 4;
+    s &= 15;
 
-    if (m_freq_domain_chroma_upsample)
-      transform_mcu_expand(mcu_row);
+    if (s)
+    {
+      if ((k + r) > 63)
+        stop_decoding(JPGD_DECODE_ERROR);
+
+      k += r;
+    }
     else
-      transform_mcu(mcu_row);
+    {
+      if (r != 15)
+        break;
 
-    m_restarts_left--;
+      if ((k + 16) > 64)
+        stop_decoding(JPGD_DECODE_ERROR);
+
+      k += 16 - 1; // - 1 because the loop counter is k
+    }
   }
 }
 
@@ -1871,9 +2371,15 @@ void jpeg_decoder::H1V1Convert()
 {
   int row = m_max_mcu_y_size - m_mcu_lines_left;
   uint8 *d = m_pScan_line_0;
-  uint8 *s = m_pSample_buf + row * 8;
+  uint8 *s = m_pCrop_sample_buf + row * 8;
+
+  if (s_simd_ycc_h1)
+  {
+    s_simd_ycc_h1(s, s + 64, s + 128, d, NULL, m_crop_mcus_per_row, 1, 64*3);
+    return;
+  }
 
-  for (int i = m_max_mcus_per_row; i > 0; i--)
+  for (int i = m_crop_mcus_per_row; i > 0; i--)
   {
     for (int j = 0; j < 8; j++)
     {
@@ -1898,10 +2404,16 @@ void jpeg_decoder::H2V1Convert()
 {
   int row = m_max_mcu_y_size - m_mcu_lines_left;
   uint8 *d0 = m_pScan_line_0;
-  uint8 *y = m_pSample_buf + row * 8;
-  uint8 *c = m_pSample_buf + 2*64 + row * 8;
+  uint8 *y = m_pCrop_sample_buf + row * 8;
+  uint8 *c = m_pCrop_sample_buf + 2*64 + row * 8;
 
-  for (int i = m_max_mcus_per_row; i > 0; i--)
+  if (s_simd_ycc_h2)
+  {
+    s_simd_ycc_h2(y, c, c + 64, d0, NULL, m_crop_mcus_per_row, 64*4);
+    return;
+  }
+
+  for (int i = m_crop_mcus_per_row; i > 0; i--)
   {
     for (int l = 0; l < 2; l++)
     {
@@ -1948,13 +2460,19 @@ void jpeg_decoder::H1V2Convert()
   uint8 *c;
 
   if (row < 8)
-    y = m_pSample_buf + row * 8;
+    y = m_pCrop_sample_buf + row * 8;
   else
-    y = m_pSample_buf + 64*1 + (row & 7) * 8;
+    y = m_pCrop_sample_buf + 64*1 + (row & 7) * 8;
 
-  c = m_pSample_buf + 64*2 + (row >> 1) * 8;
+  c = m_pCrop_sample_buf + 64*2 + (row >> 1) * 8;
 
-  for (int i = m_max_mcus_per_row; i > 0; i--)
+  if (s_simd_ycc_h1)
+  {
+    s_simd_ycc_h1(y, c, c + 64, d0, d1, m_crop_mcus_per_row, 1, 64*4);
+    return;
+  }
+
+  for (int i = m_crop_mcus_per_row; i > 0; i--)
   {
     for (int j = 0; j < 8; j++)
     {
@@ -1996,13 +2514,19 @@ void jpeg_decoder::H2V2Convert()
 	uint8 *c;
 
 	if (row < 8)
-		y = m_pSample_buf + row * 8;
+		y = m_pCrop_sample_buf + row * 8;
 	else
-		y = m_pSample_buf + 64*2 + (row & 7) * 8;
+		y = m_pCrop_sample_buf + 64*2 + (row & 7) * 8;
 
-	c = m_pSample_buf + 64*4 + (row >> 1) * 8;
+	c = m_pCrop_sample_buf + 64*4 + (row >> 1) * 8;
 
-	for (int i = m_max_mcus_per_row; i > 0; i--)
+	if (s_simd_ycc_h2)
+	{
+		s_simd_ycc_h2(y, c, c + 64, d0, d1, m_crop_mcus_per_row, 64*6);
+		return;
+	}
+
+	for (int i = m_crop_mcus_per_row; i > 0; i--)
 	{
 		for (int l = 0; l < 2; l++)
 		{
@@ -2057,9 +2581,9 @@ void jpeg_decoder::gray_convert()
 {
   int row = m_max_mcu_y_size - m_mcu_lines_left;
   uint8 *d = m_pScan_line_0;
-  uint8 *s = m_pSample_buf + row * 8;
+  uint8 *s = m_pCrop_sample_buf + row * 8;
 
-  for (int i = m_max_mcus_per_row; i > 0; i--)
+  for (int i = m_crop_mcus_per_row; i > 0; i--)
   {
     *(uint *)d = *(uint *)s;
     *(uint *)(&d[4]) = *(uint *)(&s[4]);
@@ -2069,15 +2593,95 @@ void jpeg_decoder::gray_convert()
   }
 }
 
+// Y blocks of any MCU layout to 8-bit grayscale, skipping the chroma blocks (JPGD_FLAG_LUMA_ONLY)
+// When scaling, each block holds (8 >> m_scale_shift) lines of (8 >> m_scale_shift) pixels.
+void jpeg_decoder::y_convert()
+{
+  int block_size = 8 >> m_scale_shift;
+  int row = (m_max_mcu_y_size >> m_scale_shift) - m_mcu_lines_left;
+  int h_blocks = m_comp_h_samp[0];
+  uint8 *d = m_pScan_line_0;
+  uint8 *s = m_pCrop_sample_buf + (row / block_size) * 64 * h_blocks + (row % block_size) * block_size;
+
+  if (block_size == 8)
+  {
+    for (int i = m_crop_mcus_per_row; i > 0; i--)
+    {
+      for (int k = 0; k < h_blocks; k++)
+      {
+        *(uint *)d = *(uint *)(&s[k * 64]);
+        *(uint *)(&d[4]) = *(uint *)(&s[k * 64 + 4]);
+
+        d += 8;
+      }
+
+      s += 64 * m_blocks_per_mcu;
+    }
+    return;
+  }
+
+  for (int i = m_crop_mcus_per_row; i > 0; i--)
+  {
+    for (int k = 0; k < h_blocks; k++)
+    {
+      for (int j = 0; j < block_size; j++)
+        d[j] = s[k * 64 + j];
+
+      d += block_size;
+    }
+
+    s += 64 * m_blocks_per_mcu;
+  }
+}
+
+// Like y_convert(), but writes only the pixels inside the crop rectangle, straight to pDst (see decode_luma()).
+void jpeg_decoder::y_convert_to(uint8 *pDst)
+{
+  int block_size = 8 >> m_scale_shift;
+  int row = (m_max_mcu_y_size >> m_scale_shift) - m_mcu_lines_left;
+  int h_blocks = m_comp_h_samp[0];
+  int width = m_real_dest_bytes_per_scan_line;
+  int x = -m_crop_line_ofs; // position of the current block in pDst
+  const uint8 *s = m_pCrop_sample_buf + (row / block_size) * 64 * h_blocks + (row % block_size) * block_size;
+
+  for (int i = m_crop_mcus_per_row; i > 0; i--)
+  {
+    for (int k = 0; k < h_blocks; k++, x += block_size)
+    {
+      const uint8 *b = &s[k * 64];
+
+      if ((x >= 0) && (x + block_size <= width))
+        memcpy(pDst + x, b, block_size);
+      else
+      {
+        // First or last block of the row, partly outside the crop rectangle.
+        int begin = JPGD_MAX(0, -x);
+        int end = JPGD_MIN(block_size, width - x);
+        for (int j = begin; j < end; j++)
+          pDst[x + j] = b[j];
+      }
+    }
+
+    s += 64 * m_blocks_per_mcu;
+  }
+}
+
 void jpeg_decoder::expanded_convert()
 {
   int row = m_max_mcu_y_size - m_mcu_lines_left;
 
-  uint8* Py = m_pSample_buf + (row / 8) * 64 * m_comp_h_samp[0] + (row & 7) * 8;
+  uint8* Py = m_pCrop_sample_buf + (row / 8) * 64 * m_comp_h_samp[0] + (row & 7) * 8;
 
   uint8* d = m_pScan_line_0;
 
-  for (int i = m_max_mcus_per_row; i > 0; i--)
+  if (s_simd_ycc_h1)
+  {
+    const int Cb_ofs = 64 * m_expanded_blocks_per_component;
+    s_simd_ycc_h1(Py, Py + Cb_ofs, Py + Cb_ofs * 2, d, NULL, m_crop_mcus_per_row, m_max_mcu_x_size / 8, 64 * m_expanded_blocks_per_mcu);
+    return;
+  }
+
+  for (int i = m_crop_mcus_per_row; i > 0; i--)
   {
     for (int k = 0; k < m_max_mcu_x_size; k += 8)
     {
@@ -2124,6 +2728,38 @@ void jpeg_decoder::find_eoi()
 }
 
 int jpeg_decoder::decode(const void** pScan_line, uint* pScan_line_len)
+{
+  // Lines above the crop rectangle, in the first MCU row that is decoded.
+  while (m_crop_lines_to_skip)
+  {
+    int status = decode_line(pScan_line, pScan_line_len, NULL);
+    if (status != JPGD_SUCCESS)
+      return status;
+    m_crop_lines_to_skip--;
+  }
+
+  return decode_line(pScan_line, pScan_line_len, NULL);
+}
+
+int jpeg_decoder::decode_luma(uint8 *pDst)
+{
+  if (!(m_flags & JPGD_FLAG_LUMA_ONLY))
+    return JPGD_FAILED;
+
+  const void *pScan_line;
+  uint scan_line_len;
+  while (m_crop_lines_to_skip)
+  {
+    int status = decode_line(&pScan_line, &scan_line_len, pDst);
+    if (status != JPGD_SUCCESS)
+      return status;
+    m_crop_lines_to_skip--;
+  }
+
+  return decode_line(&pScan_line, &scan_line_len, pDst);
+}
+
+int jpeg_decoder::decode_line(const void** pScan_line, uint* pScan_line_len, uint8 *pDst)
 {
   if ((m_error_code) || (!m_ready_flag))
     return JPGD_FAILED;
@@ -2136,19 +2772,49 @@ int jpeg_decoder::decode(const void** pScan_line, uint* pScan_line_len)
     if (setjmp(m_jmp_state))
       return JPGD_FAILED;
 
-    if (m_progressive_flag)
-      load_next_row();
+    if (m_pParallel_sample_buf)
+    {
+      // The workers already decoded all rows (see decode_parallel()), the converters only have to be pointed at the next one.
+      const int crop_ofs = static_cast<int>(m_pCrop_sample_buf - m_pSample_buf);
+      m_pSample_buf = m_pParallel_sample_buf + m_parallel_row * m_parallel_row_size;
+      m_pCrop_sample_buf = m_pSample_buf + crop_ofs;
+      m_parallel_row++;
+    }
     else
-      decode_next_row();
+    {
+      // MCU rows above the crop rectangle still have to be entropy decoded to get to the rows below them, but are not transformed.
+      for ( ; m_crop_mcu_rows_to_skip > 0; m_crop_mcu_rows_to_skip--)
+      {
+        if (m_progressive_flag)
+          load_next_row();
+        else
+          decode_next_row();
+      }
+
+      if (m_progressive_flag)
+        load_next_row();
+      else
+        decode_next_row();
 
-    // Find the EOI marker if that was the last row.
-    if (m_total_lines_left <= m_max_mcu_y_size)
-      find_eoi();
+      // Find the EOI marker if that was the last row. When the crop rectangle ends above the last row, decoding simply stops after it.
+      if ((m_crop_y + m_crop_height == get_scaled_height()) && (m_total_lines_left <= (m_max_mcu_y_size >> m_scale_shift)))
+        find_eoi();
+    }
 
-    m_mcu_lines_left = m_max_mcu_y_size;
+    m_mcu_lines_left = m_max_mcu_y_size >> m_scale_shift;
   }
 
-  if (m_freq_domain_chroma_upsample)
+  if (pDst)
+  {
+    y_convert_to(pDst);
+    *pScan_line = pDst;
+  }
+  else if (m_flags & JPGD_FLAG_LUMA_ONLY)
+  {
+    y_convert();
+    *pScan_line = m_pScan_line_0;
+  }
+  else if (m_freq_domain_chroma_upsample)
   {
     expanded_convert();
     *pScan_line = m_pScan_line_0;
@@ -2203,6 +2869,8 @@ int jpeg_decoder::decode(const void** pScan_line, uint* pScan_line_len)
     }
   }
 
+  if (!pDst)
+    *pScan_line = static_cast<const uint8*>(*pScan_line) + m_crop_line_ofs;
   *pScan_line_len = m_real_dest_bytes_per_scan_line;
 
   m_mcu_lines_left--;
@@ -2255,7 +2923,6 @@ void jpeg_decoder::make_huff_table(int index, huff_tables *pH)
   }
 
   memset(pH->look_up, 0, sizeof(pH->look_up));
-  memset(pH->look_up2, 0, sizeof(pH->look_up2));
   memset(pH->tree, 0, sizeof(pH->tree));
   memset(pH->code_size, 0, sizeof(pH->code_size));
 
@@ -2281,28 +2948,6 @@ void jpeg_decoder::make_huff_table(int index, huff_tables *pH)
 
         pH->look_up[code] = i;
 
-        bool has_extrabits = false;
-				int extra_bits = 0;
-        int num_extra_bits = i & 15;
-
-        int bits_to_fetch = code_size;
-        if (num_extra_bits)
-        {
-          int total_codesize = code_size + num_extra_bits;
-          if (total_codesize <= 8)
-          {
-            has_extrabits = true;
-            extra_bits = ((1 << num_extra_bits) - 1) & (code >> (8 - total_codesize));
-            JPGD_ASSERT(extra_bits <= 0x7FFF);
-            bits_to_fetch += num_extra_bits;
-          }
-        }
-
-        if (!has_extrabits)
-          pH->look_up2[code] = i | (bits_to_fetch << 8);
-        else
-          pH->look_up2[code] = i | 0x8000 | (extra_bits << 16) | (bits_to_fetch << 8);
-
         code++;
       }
     }
@@ -2315,7 +2960,6 @@ void jpeg_decoder::make_huff_table(int index, huff_tables *pH)
       if (currententry == 0)
       {
         pH->look_up[subtree] = currententry = nextfreeentry;
-        pH->look_up2[subtree] = currententry = nextfreeentry;
 
         nextfreeentry -= 2;
       }
@@ -2349,6 +2993,33 @@ void jpeg_decoder::make_huff_table(int index, huff_tables *pH)
 
     p++;
   }
+
+  // The fast table decodes the short codes with a single lookup, and their extra bits too when they fit in the table index.
+  memset(pH->look_up_fast, 0, sizeof(pH->look_up_fast));
+
+  for (p = 0; p < lastp; p++)
+  {
+    code_size = huffsize[p];
+    if ((code_size > JPGD_HUFF_FAST_BITS) || (huffcode[p] >= (1U << code_size)))
+      continue;
+
+    i = m_huff_val[index][p];
+    int num_extra_bits = i & 15;
+    int total_size = code_size + num_extra_bits;
+    uint first = huffcode[p] << (JPGD_HUFF_FAST_BITS - code_size);
+
+    for (uint ofs = 0; ofs < (1U << (JPGD_HUFF_FAST_BITS - code_size)); ofs++)
+    {
+      if (total_size <= JPGD_HUFF_FAST_BITS)
+      {
+        int extra_bits = ofs >> (JPGD_HUFF_FAST_BITS - total_size);
+        int value = JPGD_HUFF_EXTEND(extra_bits, num_extra_bits);
+        pH->look_up_fast[first + ofs] = i | (total_size << 8) | 0x2000 | static_cast<int>(static_cast<uint>(value) << 16);
+      }
+      else
+        pH->look_up_fast[first + ofs] = i | (code_size << 8);
+    }
+  }
 }
 
 // Verifies the quantization tables needed for this scan are available.
@@ -2364,20 +3035,21 @@ void jpeg_decoder::check_huff_tables()
 {
   for (int i = 0; i < m_comps_in_scan; i++)
   {
-    if ((m_spectral_start == 0) && (m_huff_num[m_comp_dc_tab[m_comp_list[i]]] == NULL))
+    if ((m_spectral_start == 0) && (!m_huff_defined[m_comp_dc_tab[m_comp_list[i]]]))
       stop_decoding(JPGD_UNDEFINED_HUFF_TABLE);
 
-    if ((m_spectral_end > 0) && (m_huff_num[m_comp_ac_tab[m_comp_list[i]]] == NULL))
+    if ((m_spectral_end > 0) && (!m_huff_defined[m_comp_ac_tab[m_comp_list[i]]]))
       stop_decoding(JPGD_UNDEFINED_HUFF_TABLE);
   }
 
   for (int i = 0; i < JPGD_MAX_HUFF_TABLES; i++)
-    if (m_huff_num[i])
+    if ((m_huff_defined[i]) && (m_huff_dirty[i]))
     {
       if (!m_pHuff_tabs[i])
-        m_pHuff_tabs[i] = (huff_tables *)alloc(sizeof(huff_tables));
+        m_pHuff_tabs[i] = (huff_tables *)alloc_from(&m_pTable_mem_blocks, sizeof(huff_tables));
 
       make_huff_table(i, m_pHuff_tabs[i]);
+      m_huff_dirty[i] = false;
     }
 }
 
@@ -2526,18 +3198,28 @@ void jpeg_decoder::init_frame()
   m_max_mcus_per_col = (m_image_y_size + (m_max_mcu_y_size - 1)) / m_max_mcu_y_size;
 
   // These values are for the *destination* pixels: after conversion.
-  if (m_scan_type == JPGD_GRAYSCALE)
+  if ((m_scan_type == JPGD_GRAYSCALE) || (m_flags & JPGD_FLAG_LUMA_ONLY))
     m_dest_bytes_per_pixel = 1;
   else
     m_dest_bytes_per_pixel = 4;
 
   m_dest_bytes_per_scan_line = ((m_image_x_size + 15) & 0xFFF0) * m_dest_bytes_per_pixel;
 
-  m_real_dest_bytes_per_scan_line = (m_image_x_size * m_dest_bytes_per_pixel);
+  m_real_dest_bytes_per_scan_line = (get_width() * m_dest_bytes_per_pixel);
+
+  // The MCUs that overlap the crop rectangle, and where the rectangle starts in the first of them.
+  const int mcu_x_size = m_max_mcu_x_size >> m_scale_shift;
+  const int mcu_y_size = m_max_mcu_y_size >> m_scale_shift;
+  m_crop_mcu_x_begin = m_crop_x / mcu_x_size;
+  m_crop_mcu_x_end = (m_crop_x + m_crop_width + mcu_x_size - 1) / mcu_x_size;
+  m_crop_mcus_per_row = m_crop_mcu_x_end - m_crop_mcu_x_begin;
+  m_crop_mcu_rows_to_skip = m_crop_y / mcu_y_size;
+  m_crop_lines_to_skip = m_crop_y - m_crop_mcu_rows_to_skip * mcu_y_size;
+  m_crop_line_ofs = (m_crop_x - m_crop_mcu_x_begin * mcu_x_size) * m_dest_bytes_per_pixel;
 
   // Initialize two scan line buffers.
   m_pScan_line_0 = (uint8 *)alloc(m_dest_bytes_per_scan_line, true);
-  if ((m_scan_type == JPGD_YH1V2) || (m_scan_type == JPGD_YH2V2))
+  if (((m_scan_type == JPGD_YH1V2) || (m_scan_type == JPGD_YH2V2)) && !(m_flags & JPGD_FLAG_LUMA_ONLY))
     m_pScan_line_1 = (uint8 *)alloc(m_dest_bytes_per_scan_line, true);
 
   m_max_blocks_per_row = m_max_mcus_per_row * m_max_blocks_per_mcu;
@@ -2558,19 +3240,23 @@ void jpeg_decoder::init_frame()
 	// Freq. domain chroma upsampling is only supported for H2V2 subsampling factor (the most common one I've seen).
   m_freq_domain_chroma_upsample = false;
 #if JPGD_SUPPORT_FREQ_DOMAIN_UPSAMPLING
-  m_freq_domain_chroma_upsample = (m_expanded_blocks_per_mcu == 4*3);
+  m_freq_domain_chroma_upsample = (m_expanded_blocks_per_mcu == 4*3) && !(m_flags & JPGD_FLAG_LUMA_ONLY);
 #endif
 
   if (m_freq_domain_chroma_upsample)
+  {
     m_pSample_buf = (uint8 *)alloc(m_expanded_blocks_per_row * 64);
+    m_pCrop_sample_buf = m_pSample_buf + m_crop_mcu_x_begin * m_expanded_blocks_per_mcu * 64;
+  }
   else
+  {
     m_pSample_buf = (uint8 *)alloc(m_max_blocks_per_row * 64);
+    m_pCrop_sample_buf = m_pSample_buf + m_crop_mcu_x_begin * m_max_blocks_per_mcu * 64;
+  }
 
-  m_total_lines_left = m_image_y_size;
+  m_total_lines_left = m_crop_lines_to_skip + m_crop_height;
 
   m_mcu_lines_left = 0;
-
-  create_look_ups();
 }
 
 // The coeff_buf series of methods originally stored the coefficients
@@ -2923,17 +3609,62 @@ void jpeg_decoder::decode_start()
     init_sequential();
 }
 
-void jpeg_decoder::decode_init(jpeg_decoder_stream *pStream)
+void jpeg_decoder::decode_init(jpeg_decoder_stream *pStream, uint flags)
 {
-  init(pStream);
+  init(pStream, flags);
   locate_sof_marker();
+
+  m_crop_width = get_scaled_width();
+  m_crop_height = get_scaled_height();
 }
 
-jpeg_decoder::jpeg_decoder(jpeg_decoder_stream *pStream)
+bool jpeg_decoder::set_crop_rect(int x, int y, int width, int height)
 {
+  if ((m_error_code) || (m_ready_flag))
+    return false;
+
+  int x_end = JPGD_MIN(x + width, m_image_x_size);
+  int y_end = JPGD_MIN(y + height, m_image_y_size);
+  x = JPGD_MAX(x, 0);
+  y = JPGD_MAX(y, 0);
+  if ((x >= x_end) || (y >= y_end))
+    return false;
+
+  // From image pixels to (scaled) output pixels, rounding outwards.
+  m_crop_x = x >> m_scale_shift;
+  m_crop_y = y >> m_scale_shift;
+  m_crop_width = ((x_end + (1 << m_scale_shift) - 1) >> m_scale_shift) - m_crop_x;
+  m_crop_height = ((y_end + (1 << m_scale_shift) - 1) >> m_scale_shift) - m_crop_y;
+  return true;
+}
+
+jpeg_decoder::jpeg_decoder(jpeg_decoder_stream *pStream, uint flags)
+{
+  m_pMem_blocks = NULL;
+  m_pTable_mem_blocks = NULL;
+
+  memset(m_huff_ac, 0, sizeof(m_huff_ac));
+  memset(m_huff_dirty, 0, sizeof(m_huff_dirty));
+  memset(m_huff_num, 0, sizeof(m_huff_num));
+  memset(m_huff_val, 0, sizeof(m_huff_val));
+  memset(m_pHuff_tabs, 0, sizeof(m_pHuff_tabs));
+
+  m_pExecutor = NULL;
+  memset(m_pWorkers, 0, sizeof(m_pWorkers));
+
+  create_look_ups();
+
   if (setjmp(m_jmp_state))
     return;
-  decode_init(pStream);
+  decode_init(pStream, flags);
+}
+
+int jpeg_decoder::reset(jpeg_decoder_stream *pStream, uint flags)
+{
+  if (setjmp(m_jmp_state))
+    return JPGD_FAILED;
+  decode_init(pStream, flags);
+  return JPGD_SUCCESS;
 }
 
 int jpeg_decoder::begin_decoding()
@@ -2949,6 +3680,8 @@ int jpeg_decoder::begin_decoding()
 
   decode_start();
 
+  decode_parallel();
+
   m_ready_flag = true;
 
   return JPGD_SUCCESS;
@@ -2956,6 +3689,8 @@ int jpeg_decoder::begin_decoding()
 
 jpeg_decoder::~jpeg_decoder()
 {
+  for (int i = 0; i < JPGD_MAX_THREADS; i++)
+    delete m_pWorkers[i];
   free_all_blocks();
 }
 
@@ -3038,6 +3773,24 @@ bool jpeg_decoder_mem_stream::open(const uint8 *pSrc_data, uint size)
   return true;
 }
 
+bool jpeg_decoder_mem_stream::open_in_place(uint8 *pSrc_data, uint size)
+{
+  open(pSrc_data, size);
+  m_pIn_place_data = pSrc_data;
+  return true;
+}
+
+uint8 *jpeg_decoder_mem_stream::get_in_place_buffer(int *pSize)
+{
+  // The whole buffer is handed out at once, after that the stream is at its end.
+  if ((!m_pIn_place_data) || (m_ofs != 0))
+    return NULL;
+
+  *pSize = m_size;
+  m_ofs = m_size;
+  return m_pIn_place_data;
+}
+
 int jpeg_decoder_mem_stream::read(uint8 *pBuf, int max_bytes_to_read, bool *pEOF_flag)
 {
   *pEOF_flag = false;
@@ -3058,7 +3811,7 @@ int jpeg_decoder_mem_stream::read(uint8 *pBuf, int max_bytes_to_read, bool *pEOF
   return max_bytes_to_read;
 }
 
-unsigned char *decompress_jpeg_image_from_stream(jpeg_decoder_stream *pStream, int *width, int *height, int *actual_comps, int req_comps)
+unsigned char *decompress_jpeg_image_from_stream(jpeg_decoder_stream *pStream, int *width, int *height, int *actual_comps, int req_comps, uint flags)
 {
   if (!actual_comps)
     return NULL;
@@ -3070,7 +3823,14 @@ unsigned char *decompress_jpeg_image_from_stream(jpeg_decoder_stream *pStream, i
   if ((req_comps != 1) && (req_comps != 3) && (req_comps != 4))
     return NULL;
 
-  jpeg_decoder decoder(pStream);
+  if ((flags & (JPGD_FLAG_SCALE_1_2 | JPGD_FLAG_SCALE_1_4 | JPGD_FLAG_SCALE_1_8)) && (req_comps != 1))
+    return NULL;
+
+  // Grayscale output only needs the luma, so don't decode and convert the chroma just to convert it back.
+  if (req_comps == 1)
+    flags |= JPGD_FLAG_LUMA_ONLY;
+
+  jpeg_decoder decoder(pStream, flags);
   if (decoder.get_error_code() != JPGD_SUCCESS)
     return NULL;
 
@@ -3100,9 +3860,9 @@ unsigned char *decompress_jpeg_image_from_stream(jpeg_decoder_stream *pStream, i
 
     uint8 *pDst = pImage_data + y * dst_bpl;
 
-    if (((req_comps == 1) && (decoder.get_num_components() == 1)) || ((req_comps == 4) && (decoder.get_num_components() == 3)))
+    if (decoder.get_bytes_per_pixel() == req_comps)
       memcpy(pDst, pScan_line, dst_bpl);
-    else if (decoder.get_num_components() == 1)
+    else if (decoder.get_bytes_per_pixel() == 1)
     {
       if (req_comps == 3)
       {
@@ -22,6 +22,7 @@ namespace jpgd
   typedef unsigned short uint16;
   typedef unsigned int   uint;
   typedef   signed int   int32;
+  typedef unsigned long long uint64;
 
   // Loads a JPEG image from a memory buffer or a file.
   // req_comps can be 1 (grayscale), 3 (RGB), or 4 (RGBA).
@@ -62,8 +63,14 @@ namespace jpgd
     // max_bytes_to_read - maximum bytes that can be written to pBuf
     // pEOF_flag - set this to true if at end of stream (no more bytes remaining)
     // Returns -1 on error, otherwise return the number of bytes actually written to the buffer (which may be 0).
-    // Notes: This method will be called in a loop until you set *pEOF_flag to true or the internal buffer is full.
+    // Notes: This method will be called in a loop until it returns some data or you set *pEOF_flag to true. The decoder uses the data before reading more,
+    // so a stream that is still receiving the JPEG can return what it has so far.
     virtual int read(uint8 *pBuf, int max_bytes_to_read, bool *pEOF_flag) = 0;
+
+    // Streams that already hold the entire JPEG in memory may return it here, so the decoder reads it in place instead of copying it into its input buffer.
+    // The buffer must stay valid during decoding, and must be writable: the decoder writes EOI padding into the JPGD_IN_PLACE_PAD_SIZE bytes following the data.
+    // Called instead of read() when the decoder needs data. Return NULL (the default) to use read().
+    virtual uint8 *get_in_place_buffer(int *pSize) { (void)pSize; return NULL; }
   };
 
   // stdio FILE stream class.
@@ -86,65 +93,125 @@ namespace jpgd
   };
 
   // Memory stream class.
+  // When opened with open_in_place() the decoder reads the data directly from the buffer, without copying it.
   class jpeg_decoder_mem_stream : public jpeg_decoder_stream
   {
     const uint8 *m_pSrc_data;
+    uint8 *m_pIn_place_data;
     uint m_ofs, m_size;
 
   public:
-    jpeg_decoder_mem_stream() : m_pSrc_data(NULL), m_ofs(0), m_size(0) { }
-    jpeg_decoder_mem_stream(const uint8 *pSrc_data, uint size) : m_pSrc_data(pSrc_data), m_ofs(0), m_size(size) { }
+    jpeg_decoder_mem_stream() : m_pSrc_data(NULL), m_pIn_place_data(NULL), m_ofs(0), m_size(0) { }
+    jpeg_decoder_mem_stream(const uint8 *pSrc_data, uint size) : m_pSrc_data(pSrc_data), m_pIn_place_data(NULL), m_ofs(0), m_size(size) { }
 
     virtual ~jpeg_decoder_mem_stream() { }
 
     bool open(const uint8 *pSrc_data, uint size);
-    void close() { m_pSrc_data = NULL; m_ofs = 0; m_size = 0; }
+    // The buffer must have JPGD_IN_PLACE_PAD_SIZE writable bytes after the data.
+    bool open_in_place(uint8 *pSrc_data, uint size);
+    void close() { m_pSrc_data = NULL; m_pIn_place_data = NULL; m_ofs = 0; m_size = 0; }
     
     virtual int read(uint8 *pBuf, int max_bytes_to_read, bool *pEOF_flag);
+    virtual uint8 *get_in_place_buffer(int *pSize);
   };
 
   // Loads JPEG file from a jpeg_decoder_stream.
-  unsigned char *decompress_jpeg_image_from_stream(jpeg_decoder_stream *pStream, int *width, int *height, int *actual_comps, int req_comps);
+  // When req_comps is 1, color images are decoded with JPGD_FLAG_LUMA_ONLY, so the chroma is never decoded or converted.
+  // flags may contain one of the JPGD_FLAG_SCALE_* flags to get a reduced size image; this requires req_comps to be 1. width/height are set to the reduced size.
+  unsigned char *decompress_jpeg_image_from_stream(jpeg_decoder_stream *pStream, int *width, int *height, int *actual_comps, int req_comps, uint flags = 0);
 
   enum 
   { 
-    JPGD_IN_BUF_SIZE = 8192, JPGD_MAX_BLOCKS_PER_MCU = 10, JPGD_MAX_HUFF_TABLES = 8, JPGD_MAX_QUANT_TABLES = 4, 
-    JPGD_MAX_COMPONENTS = 4, JPGD_MAX_COMPS_IN_SCAN = 4, JPGD_MAX_BLOCKS_PER_ROW = 8192, JPGD_MAX_HEIGHT = 16384, JPGD_MAX_WIDTH = 16384 
+    JPGD_IN_BUF_SIZE = 8192, JPGD_IN_PLACE_PAD_SIZE = 128, JPGD_MAX_BLOCKS_PER_MCU = 10, JPGD_MAX_HUFF_TABLES = 8, JPGD_MAX_QUANT_TABLES = 4, 
+    JPGD_MAX_COMPONENTS = 4, JPGD_MAX_COMPS_IN_SCAN = 4, JPGD_MAX_BLOCKS_PER_ROW = 8192, JPGD_MAX_HEIGHT = 16384, JPGD_MAX_WIDTH = 16384,
+    JPGD_MAX_THREADS = 16, JPGD_HUFF_FAST_BITS = 10
   };
           
+  // Decoder flags, passed to the jpeg_decoder constructor.
+  enum jpgd_flags
+  {
+    // Only decode the Y (luma) component: the Cb/Cr blocks are Huffman decoded (they have to be, to find the next block), but not dequantized,
+    // transformed or color converted. decode() returns 8-bit luma scan lines for every image, and get_bytes_per_pixel() returns 1.
+    JPGD_FLAG_LUMA_ONLY = 1,
+    // Decode a reduced size image, using a reduced size IDCT on the lowest frequency coefficients of each block. 1/8 only uses the DC coefficients.
+    // The scaled size is the image size divided by the scale, rounded up. These flags imply JPGD_FLAG_LUMA_ONLY. 
+    JPGD_FLAG_SCALE_1_2 = 2, JPGD_FLAG_SCALE_1_4 = 4, JPGD_FLAG_SCALE_1_8 = 8
+  };
+
   typedef int16 jpgd_quant_t;
   typedef int16 jpgd_block_t;
 
+  // Runs the restart intervals of an image in parallel, see jpeg_decoder::set_executor().
+  class jpeg_decoder_executor
+  {
+  public:
+    virtual ~jpeg_decoder_executor() { }
+
+    // Number of tasks that can run at the same time. At most JPGD_MAX_THREADS are used.
+    virtual int get_num_threads() = 0;
+
+    // Calls pTask(pData, i) for each i from 0 to count - 1, spread over the threads, and returns when all calls have returned.
+    virtual void run(void (*pTask)(void *pData, int index), void *pData, int count) = 0;
+  };
+
   class jpeg_decoder
   {
   public:
     // Call get_error_code() after constructing to determine if the stream is valid or not. You may call the get_width(), get_height(), etc.
     // methods after the constructor is called. You may then either destruct the object, or begin decoding the image by calling begin_decoding(), then decode() on each scanline.
-    jpeg_decoder(jpeg_decoder_stream *pStream);
+    // flags is a combination of jpgd_flags.
+    jpeg_decoder(jpeg_decoder_stream *pStream, uint flags = 0);
 
     ~jpeg_decoder();
 
+    // Start over on a new stream, as if the decoder was destructed and constructed again, but keep the memory it allocated.
+    // The lookup tables are kept as well, and so are the Huffman decoding tables when the stream defines the same tables as the previous one.
+    // Decoding a series of images of the same shape this way does not allocate any memory after the first image.
+    // Returns JPGD_SUCCESS, or JPGD_FAILED when the stream is not valid. Call get_error_code() for more info.
+    int reset(jpeg_decoder_stream *pStream, uint flags = 0);
+
     // Call this method after constructing the object to begin decompression.
     // If JPGD_SUCCESS is returned you may then call decode() on each scanline.
     int begin_decoding();
 
     // Returns the next scan line.
-    // For grayscale images, pScan_line will point to a buffer containing 8-bit pixels (get_bytes_per_pixel() will return 1). 
+    // For grayscale images, and for all images decoded with JPGD_FLAG_LUMA_ONLY, pScan_line will point to a buffer containing 8-bit pixels (get_bytes_per_pixel() will return 1). 
     // Otherwise, it will always point to a buffer containing 32-bit RGBA pixels (A will always be 255, and get_bytes_per_pixel() will return 4).
     // Returns JPGD_SUCCESS if a scan line has been returned.
     // Returns JPGD_DONE if all scan lines have been returned.
     // Returns JPGD_FAILED if an error occurred. Call get_error_code() for a more info.
     int decode(const void** pScan_line, uint* pScan_line_len);
+
+    // Like decode(), but writes the next scan line straight into pDst, which must hold get_width() bytes, instead of the decoder's own buffer.
+    // Saves copying each line when the caller keeps the whole image. Only for images decoded with JPGD_FLAG_LUMA_ONLY, returns JPGD_FAILED otherwise.
+    int decode_luma(uint8 *pDst);
     
     inline jpgd_status get_error_code() const { return m_error_code; }
 
-    inline int get_width() const { return m_image_x_size; }
-    inline int get_height() const { return m_image_y_size; }
+    // Only decode the part of the image inside this rectangle, in pixels of the full size image. Call before begin_decoding().
+    // The rectangle is clipped to the image. Huffman decoding still has to go through all MCUs up to the bottom of the rectangle,
+    // but the IDCT and color conversion are only done for MCUs that overlap it, and decoding stops after its last line.
+    // When scaling, the rectangle is scaled down too, rounding outwards.
+    // Returns false if the rectangle does not overlap the image, or decoding was already started.
+    bool set_crop_rect(int x, int y, int width, int height);
+
+    // Decode images that are split into restart intervals (DRI) on the threads of the executor. Call before begin_decoding(), the setting is kept by reset().
+    // begin_decoding() then finds the restart markers, and decodes the intervals down to the bottom of the crop rectangle in parallel, each with its own decoder.
+    // decode() only converts the decoded rows to scan lines. Images without restart intervals, progressive images, and streams
+    // that are not in memory (see jpeg_decoder_mem_stream::open_in_place()) are decoded one row at a time as usual.
+    inline void set_executor(jpeg_decoder_executor *pExecutor) { m_pExecutor = pExecutor; }
+
+    // True after begin_decoding() when the restart intervals were decoded on the executor, false when the image is decoded a row at a time.
+    inline bool is_parallel() const { return m_pParallel_sample_buf != NULL; }
+
+    // Size of the decoded image, which is reduced when decoding with one of the JPGD_FLAG_SCALE_* flags, or to the crop rectangle.
+    inline int get_width() const { return m_crop_width; }
+    inline int get_height() const { return m_crop_height; }
 
     inline int get_num_components() const { return m_comps_in_frame; }
 
     inline int get_bytes_per_pixel() const { return m_dest_bytes_per_pixel; }
-    inline int get_bytes_per_scan_line() const { return m_image_x_size * get_bytes_per_pixel(); }
+    inline int get_bytes_per_scan_line() const { return get_width() * get_bytes_per_pixel(); }
 
     // Returns the total number of bytes actually consumed by the decoder (which should equal the actual size of the JPEG file).
     inline int get_total_bytes_read() const { return m_total_bytes_read; }
@@ -159,9 +226,10 @@ namespace jpgd
     {
       bool ac_table;
       uint  look_up[256];
-      uint  look_up2[256];
       uint8 code_size[256];
       uint  tree[512];
+      // Codes of up to JPGD_HUFF_FAST_BITS bits: symbol | (bits to consume << 8) | (0x2000 and the extended value << 16 when the extra bits fit too). 0 for longer codes.
+      int   look_up_fast[1 << JPGD_HUFF_FAST_BITS];
     };
 
     struct coeff_buf
@@ -181,12 +249,17 @@ namespace jpgd
     };
 
     jmp_buf m_jmp_state;
-    mem_block *m_pMem_blocks;
+    uint m_flags;
+    int m_scale_shift;                            // log2 of the JPGD_FLAG_SCALE_* scale, 0 for full size
+    mem_block *m_pMem_blocks;                     // memory for one image, re-used by reset()
+    mem_block *m_pTable_mem_blocks;               // memory for the Huffman tables, which are kept by reset()
     int m_image_x_size;
     int m_image_y_size;
     jpeg_decoder_stream *m_pStream;
     int m_progressive_flag;
     uint8 m_huff_ac[JPGD_MAX_HUFF_TABLES];
+    bool m_huff_defined[JPGD_MAX_HUFF_TABLES];    // table was defined by the current stream
+    bool m_huff_dirty[JPGD_MAX_HUFF_TABLES];      // m_pHuff_tabs has not been built from the current m_huff_num/m_huff_val yet
     uint8* m_huff_num[JPGD_MAX_HUFF_TABLES];      // pointer to number of Huffman codes per bit size
     uint8* m_huff_val[JPGD_MAX_HUFF_TABLES];      // pointer to Huffman codes per bit size
     jpgd_quant_t* m_quant[JPGD_MAX_QUANT_TABLES]; // pointer to quantization tables
@@ -231,6 +304,8 @@ namespace jpgd
     uint8 m_in_buf_pad_end[128];
     int m_bits_left;
     uint m_bit_buf;
+    uint64 m_bit_buf64;     // bit buffer of the baseline entropy decoder, valid bits are at the top
+    int m_bit_count64;
     int m_restart_interval;
     int m_restarts_left;
     int m_next_restart_num;
@@ -251,13 +326,38 @@ namespace jpgd
     int m_cbg[256];
     uint8* m_pScan_line_0;
     uint8* m_pScan_line_1;
+    int m_crop_x, m_crop_y, m_crop_width, m_crop_height; // crop rectangle, in (scaled) output pixels
+    int m_crop_mcu_x_begin, m_crop_mcu_x_end;     // MCU columns overlapping the crop rectangle
+    int m_crop_mcus_per_row;
+    int m_crop_mcu_rows_to_skip;                  // MCU rows above the crop rectangle that still have to be decoded
+    int m_crop_lines_to_skip;                     // lines above the crop rectangle in its first MCU row
+    int m_crop_line_ofs;                          // bytes from the start of a converted line to the crop rectangle
+    uint8* m_pCrop_sample_buf;                    // sample buffer, from the first MCU overlapping the crop rectangle
     jpgd_status m_error_code;
     bool m_ready_flag;
     int m_total_bytes_read;
+    uint8* m_pIn_place_data;                      // the whole stream, when it was read in place
+    int m_in_place_size;
+    uint8* m_pScan_data;                          // first byte of the entropy coded data of the current scan
+    jpeg_decoder_executor* m_pExecutor;
+    jpeg_decoder* m_pWorkers[JPGD_MAX_THREADS];   // decoders for the restart intervals, kept for the next image
+    jpeg_decoder_mem_stream m_worker_streams[JPGD_MAX_THREADS];
+    int m_num_workers;                            // workers used for the current image
+    const uint8** m_pInterval_data;               // first byte of each restart interval
+    int m_parallel_first_mcu, m_parallel_end_mcu; // MCUs decoded by the workers
+    uint8* m_pParallel_sample_buf;                // sample buffers of all MCU rows decoded by the workers, or NULL
+    int m_parallel_row_size;
+    int m_parallel_row;                           // next row in m_pParallel_sample_buf to convert
+
+    inline int get_scaled_width() const { return (m_image_x_size + (1 << m_scale_shift) - 1) >> m_scale_shift; }
+    inline int get_scaled_height() const { return (m_image_y_size + (1 << m_scale_shift) - 1) >> m_scale_shift; }
 
+    int decode_line(const void** pScan_line, uint* pScan_line_len, uint8 *pDst);
     void free_all_blocks();
     JPGD_NORETURN void stop_decoding(jpgd_status status);
+    void rewind_all_blocks();
     void *alloc(size_t n, bool zero = false);
+    void *alloc_from(mem_block **ppBlocks, size_t n, bool zero = false);
     void word_clear(void *p, uint16 c, uint n);
     void prep_in_buffer();
     void read_dht_marker();
@@ -271,7 +371,7 @@ namespace jpgd
     void locate_soi_marker();
     void locate_sof_marker();
     int locate_sos_marker();
-    void init(jpeg_decoder_stream * pStream);
+    void init(jpeg_decoder_stream * pStream, uint flags);
     void create_look_ups();
     void fix_in_buffer();
     void transform_mcu(int mcu_row);
@@ -279,7 +379,11 @@ namespace jpgd
     coeff_buf* coeff_buf_open(int block_num_x, int block_num_y, int block_len_x, int block_len_y);
     inline jpgd_block_t *coeff_buf_getp(coeff_buf *cb, int block_x, int block_y);
     void load_next_row();
+    void decode_mcu();
     void decode_next_row();
+    bool decode_parallel();
+    void decode_intervals(const jpeg_decoder *pMain, int first_interval, int end_interval);
+    static void decode_intervals_task(void *pData, int index);
     void make_huff_table(int index, huff_tables *pH);
     void check_quant_tables();
     void check_huff_tables();
@@ -291,12 +395,15 @@ namespace jpgd
     void init_progressive();
     void init_sequential();
     void decode_start();
-    void decode_init(jpeg_decoder_stream * pStream);
+    void decode_init(jpeg_decoder_stream * pStream, uint flags);
     void H2V2Convert();
     void H2V1Convert();
     void H1V2Convert();
     void H1V1Convert();
     void gray_convert();
+    void y_convert();
+    void y_convert_to(uint8 *pDst);
+    void skip_block(int component_id);
     void expanded_convert();
     void find_eoi();
     inline uint get_char();
@@ -306,7 +413,9 @@ namespace jpgd
     inline uint get_bits(int num_bits);
     inline uint get_bits_no_markers(int numbits);
     inline int huff_decode(huff_tables *pH);
-    inline int huff_decode(huff_tables *pH, int& extrabits);
+    void sync_bit_buf64();
+    inline void fill_bit_buf64();
+    inline int huff_decode_fast(huff_tables *pH, int& value);
     static inline uint8 clamp(int i);
     static void decode_block_dc_first(jpeg_decoder *pD, int component_id, int block_x, int block_y);
     static void decode_block_dc_refine(jpeg_decoder *pD, int component_id, int block_x, int block_y);
@@ -0,0 +1,110 @@
+// jpgd_avx2.cpp - AVX2 version of the jpgd IDCT, see jpgd_simd.h.
+// Compiled with -mavx2. Works on all 8 rows or columns at once, in 32-bit lanes, so all intermediate values are exactly those of the scalar version.
+#include "jpgd_simd.h"
+
+#include <immintrin.h>
+
+namespace jpgd
+{
+  namespace
+  {
+    inline __m256i mul(__m256i a, int32 c) { return _mm256_mullo_epi32(a, _mm256_set1_epi32(c)); }
+    inline __m256i add(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+    inline __m256i sub(__m256i a, __m256i b) { return _mm256_sub_epi32(a, b); }
+
+    // The same operations as Row<8>::idct() and Col<8>::idct() in jpgd.cpp, up to the descaling.
+    inline void idct_1d(const __m256i *in, __m256i *out)
+    {
+      const __m256i z2 = in[2], z3 = in[6];
+
+      const __m256i z1 = mul(add(z2, z3), JPGD_FIX_0_541196100);
+      const __m256i tmp2 = add(z1, mul(z3, -JPGD_FIX_1_847759065));
+      const __m256i tmp3 = add(z1, mul(z2, JPGD_FIX_0_765366865));
+
+      const __m256i tmp0 = _mm256_slli_epi32(add(in[0], in[4]), JPGD_IDCT_CONST_BITS);
+      const __m256i tmp1 = _mm256_slli_epi32(sub(in[0], in[4]), JPGD_IDCT_CONST_BITS);
+
+      const __m256i tmp10 = add(tmp0, tmp3), tmp13 = sub(tmp0, tmp3), tmp11 = add(tmp1, tmp2), tmp12 = sub(tmp1, tmp2);
+
+      const __m256i atmp0 = in[7], atmp1 = in[5], atmp2 = in[3], atmp3 = in[1];
+
+      const __m256i bz1 = add(atmp0, atmp3), bz2 = add(atmp1, atmp2), bz3 = add(atmp0, atmp2), bz4 = add(atmp1, atmp3);
+      const __m256i bz5 = mul(add(bz3, bz4), JPGD_FIX_1_175875602);
+
+      const __m256i az1 = mul(bz1, -JPGD_FIX_0_899976223);
+      const __m256i az2 = mul(bz2, -JPGD_FIX_2_562915447);
+      const __m256i az3 = add(mul(bz3, -JPGD_FIX_1_961570560), bz5);
+      const __m256i az4 = add(mul(bz4, -JPGD_FIX_0_390180644), bz5);
+
+      const __m256i btmp0 = add(add(mul(atmp0, JPGD_FIX_0_298631336), az1), az3);
+      const __m256i btmp1 = add(add(mul(atmp1, JPGD_FIX_2_053119869), az2), az4);
+      const __m256i btmp2 = add(add(mul(atmp2, JPGD_FIX_3_072711026), az2), az3);
+      const __m256i btmp3 = add(add(mul(atmp3, JPGD_FIX_1_501321110), az1), az4);
+
+      out[0] = add(tmp10, btmp3);
+      out[7] = sub(tmp10, btmp3);
+      out[1] = add(tmp11, btmp2);
+      out[6] = sub(tmp11, btmp2);
+      out[2] = add(tmp12, btmp1);
+      out[5] = sub(tmp12, btmp1);
+      out[3] = add(tmp13, btmp0);
+      out[4] = sub(tmp13, btmp0);
+    }
+
+    inline void transpose8x8(__m256i *r)
+    {
+      __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]), t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+      __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]), t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+      __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]), t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+      __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]), t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+      __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+      __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+      __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+      __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+
+      r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+      r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+      r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+      r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+      r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+      r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+      r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+      r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+    }
+  }
+
+  void idct_avx2(const jpgd_block_t *pSrc, uint8 *pDst)
+  {
+    __m256i m[8], out[8];
+
+    for (int r = 0; r < 8; r++)
+      m[r] = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + r * 8)));
+
+    // Rows, each lane is one row of the block.
+    transpose8x8(m);
+    idct_1d(m, out);
+    const __m256i row_round = _mm256_set1_epi32(1 << (JPGD_IDCT_CONST_BITS - JPGD_IDCT_PASS1_BITS - 1));
+    for (int i = 0; i < 8; i++)
+      m[i] = _mm256_srai_epi32(add(out[i], row_round), JPGD_IDCT_CONST_BITS - JPGD_IDCT_PASS1_BITS);
+
+    // Columns, each lane is one column of the block.
+    transpose8x8(m);
+    idct_1d(m, out);
+    const int col_shift = JPGD_IDCT_CONST_BITS + JPGD_IDCT_PASS1_BITS + 3;
+    const __m256i col_round = _mm256_set1_epi32((128 << col_shift) + (1 << (col_shift - 1)));
+    for (int i = 0; i < 8; i++)
+      m[i] = _mm256_srai_epi32(add(out[i], col_round), col_shift);
+
+    // Saturating packs clamp to 0-255 like CLAMP() does. They work within 128-bit lanes, so the rows are put back in order afterwards.
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    for (int r = 0; r < 8; r += 4)
+    {
+      __m256i rows01 = _mm256_packs_epi32(m[r], m[r + 1]);
+      __m256i rows23 = _mm256_packs_epi32(m[r + 2], m[r + 3]);
+      __m256i pixels = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(rows01, rows23), order);
+      _mm256_storeu_si256(reinterpret_cast<__m256i *>(pDst + r * 8), pixels);
+    }
+  }
+
+} // namespace jpgd
@@ -0,0 +1,219 @@
+// jpgd_neon.cpp - NEON versions of the jpgd IDCT and colour conversion, see jpgd_simd.h.
+// Compiled with -mfpu=neon on 32-bit ARM. The IDCT works on 4 rows or columns at a time, in 32-bit lanes, so all intermediate values are exactly those of the scalar version.
+// The colour conversion works on 8 pixels at a time.
+#include "jpgd_simd.h"
+
+#include <arm_neon.h>
+
+namespace jpgd
+{
+  namespace
+  {
+    inline int32x4_t mul(int32x4_t a, int32 c) { return vmulq_n_s32(a, c); }
+    inline int32x4_t add(int32x4_t a, int32x4_t b) { return vaddq_s32(a, b); }
+    inline int32x4_t sub(int32x4_t a, int32x4_t b) { return vsubq_s32(a, b); }
+
+    // The same operations as Row<8>::idct() and Col<8>::idct() in jpgd.cpp, up to the descaling.
+    inline void idct_1d(const int32x4_t *in, int32x4_t *out)
+    {
+      const int32x4_t z2 = in[2], z3 = in[6];
+
+      const int32x4_t z1 = mul(add(z2, z3), JPGD_FIX_0_541196100);
+      const int32x4_t tmp2 = add(z1, mul(z3, -JPGD_FIX_1_847759065));
+      const int32x4_t tmp3 = add(z1, mul(z2, JPGD_FIX_0_765366865));
+
+      const int32x4_t tmp0 = vshlq_n_s32(add(in[0], in[4]), JPGD_IDCT_CONST_BITS);
+      const int32x4_t tmp1 = vshlq_n_s32(sub(in[0], in[4]), JPGD_IDCT_CONST_BITS);
+
+      const int32x4_t tmp10 = add(tmp0, tmp3), tmp13 = sub(tmp0, tmp3), tmp11 = add(tmp1, tmp2), tmp12 = sub(tmp1, tmp2);
+
+      const int32x4_t atmp0 = in[7], atmp1 = in[5], atmp2 = in[3], atmp3 = in[1];
+
+      const int32x4_t bz1 = add(atmp0, atmp3), bz2 = add(atmp1, atmp2), bz3 = add(atmp0, atmp2), bz4 = add(atmp1, atmp3);
+      const int32x4_t bz5 = mul(add(bz3, bz4), JPGD_FIX_1_175875602);
+
+      const int32x4_t az1 = mul(bz1, -JPGD_FIX_0_899976223);
+      const int32x4_t az2 = mul(bz2, -JPGD_FIX_2_562915447);
+      const int32x4_t az3 = add(mul(bz3, -JPGD_FIX_1_961570560), bz5);
+      const int32x4_t az4 = add(mul(bz4, -JPGD_FIX_0_390180644), bz5);
+
+      const int32x4_t btmp0 = add(add(mul(atmp0, JPGD_FIX_0_298631336), az1), az3);
+      const int32x4_t btmp1 = add(add(mul(atmp1, JPGD_FIX_2_053119869), az2), az4);
+      const int32x4_t btmp2 = add(add(mul(atmp2, JPGD_FIX_3_072711026), az2), az3);
+      const int32x4_t btmp3 = add(add(mul(atmp3, JPGD_FIX_1_501321110), az1), az4);
+
+      out[0] = add(tmp10, btmp3);
+      out[7] = sub(tmp10, btmp3);
+      out[1] = add(tmp11, btmp2);
+      out[6] = sub(tmp11, btmp2);
+      out[2] = add(tmp12, btmp1);
+      out[5] = sub(tmp12, btmp1);
+      out[3] = add(tmp13, btmp0);
+      out[4] = sub(tmp13, btmp0);
+    }
+
+    inline void transpose4x4(int32x4_t &r0, int32x4_t &r1, int32x4_t &r2, int32x4_t &r3)
+    {
+      int32x4x2_t t01 = vtrnq_s32(r0, r1);
+      int32x4x2_t t23 = vtrnq_s32(r2, r3);
+      r0 = vcombine_s32(vget_low_s32(t01.val[0]), vget_low_s32(t23.val[0]));
+      r1 = vcombine_s32(vget_low_s32(t01.val[1]), vget_low_s32(t23.val[1]));
+      r2 = vcombine_s32(vget_high_s32(t01.val[0]), vget_high_s32(t23.val[0]));
+      r3 = vcombine_s32(vget_high_s32(t01.val[1]), vget_high_s32(t23.val[1]));
+    }
+
+    // Transposes an 8x8 matrix stored as m[row][half], where half 0 holds columns 0-3 and half 1 columns 4-7, into t[column][half].
+    inline void transpose8x8(int32x4_t m[8][2], int32x4_t t[8][2])
+    {
+      for (int hr = 0; hr < 2; hr++)
+      {
+        for (int hc = 0; hc < 2; hc++)
+        {
+          int32x4_t r0 = m[hr * 4 + 0][hc], r1 = m[hr * 4 + 1][hc], r2 = m[hr * 4 + 2][hc], r3 = m[hr * 4 + 3][hc];
+          transpose4x4(r0, r1, r2, r3);
+          t[hc * 4 + 0][hr] = r0;
+          t[hc * 4 + 1][hr] = r1;
+          t[hc * 4 + 2][hr] = r2;
+          t[hc * 4 + 3][hr] = r3;
+        }
+      }
+    }
+
+    // (a * ca + b * cb + 32768) >> 16 for 8 signed 16-bit lanes.
+    inline int16x8_t madd_descale(int16x8_t a, int16x8_t b, int16 ca, int16 cb)
+    {
+      const int32x4_t round = vdupq_n_s32(32768);
+      int32x4_t lo = vmlal_n_s16(vmlal_n_s16(round, vget_low_s16(a), ca), vget_low_s16(b), cb);
+      int32x4_t hi = vmlal_n_s16(vmlal_n_s16(round, vget_high_s16(a), ca), vget_high_s16(b), cb);
+      return vcombine_s16(vshrn_n_s32(lo, 16), vshrn_n_s32(hi, 16));
+    }
+
+    // 8 samples widened to 16 bits.
+    inline int16x8_t load8(const uint8 *p)
+    {
+      return vreinterpretq_s16_u16(vmovl_u8(vld1_u8(p)));
+    }
+
+    // The values m_crr[cr], (m_crg[cr] + m_cbg[cb]) >> 16 and m_cbb[cb] give for 8 chroma samples.
+    inline void chroma_offsets(const uint8 *pCb, const uint8 *pCr, int16x8_t &rc, int16x8_t &gc, int16x8_t &bc)
+    {
+      const int16x8_t center = vdupq_n_s16(128);
+      const int16x8_t cb = vsubq_s16(load8(pCb), center);
+      const int16x8_t cr = vsubq_s16(load8(pCr), center);
+
+      rc = vaddq_s16(cr, madd_descale(cr, cr, JPGD_YCC_CR_R, 0));
+      gc = vsubq_s16(madd_descale(cr, cb, JPGD_YCC_CR_G, JPGD_YCC_CB_G), cr);
+      bc = vaddq_s16(vaddq_s16(cb, cb), madd_descale(cb, cb, JPGD_YCC_CB_B, 0));
+    }
+
+    // Stores 8 RGBA pixels. The saturating narrows clamp to 0-255 like clamp() does.
+    inline void store_rgba(uint8 *pDst, int16x8_t y, int16x8_t rc, int16x8_t gc, int16x8_t bc)
+    {
+      uint8x8x4_t rgba;
+      rgba.val[0] = vqmovun_s16(vaddq_s16(y, rc));
+      rgba.val[1] = vqmovun_s16(vaddq_s16(y, gc));
+      rgba.val[2] = vqmovun_s16(vaddq_s16(y, bc));
+      rgba.val[3] = vdup_n_u8(255);
+      vst4_u8(pDst, rgba);
+    }
+  }
+
+  void idct_neon(const jpgd_block_t *pSrc, uint8 *pDst)
+  {
+    int32x4_t m[8][2], t[8][2], in[8], out[8];
+
+    for (int r = 0; r < 8; r++)
+    {
+      int16x8_t v = vld1q_s16(pSrc + r * 8);
+      m[r][0] = vmovl_s16(vget_low_s16(v));
+      m[r][1] = vmovl_s16(vget_high_s16(v));
+    }
+
+    // Rows, each lane is one row of the block.
+    transpose8x8(m, t);
+    const int32x4_t row_round = vdupq_n_s32(1 << (JPGD_IDCT_CONST_BITS - JPGD_IDCT_PASS1_BITS - 1));
+    for (int h = 0; h < 2; h++)
+    {
+      for (int i = 0; i < 8; i++)
+        in[i] = t[i][h];
+      idct_1d(in, out);
+      for (int i = 0; i < 8; i++)
+        t[i][h] = vshrq_n_s32(add(out[i], row_round), JPGD_IDCT_CONST_BITS - JPGD_IDCT_PASS1_BITS);
+    }
+
+    // Columns, each lane is one column of the block.
+    transpose8x8(t, m);
+    const int col_shift = JPGD_IDCT_CONST_BITS + JPGD_IDCT_PASS1_BITS + 3;
+    const int32x4_t col_round = vdupq_n_s32((128 << col_shift) + (1 << (col_shift - 1)));
+    int32x4_t pixels[8][2];
+    for (int h = 0; h < 2; h++)
+    {
+      for (int i = 0; i < 8; i++)
+        in[i] = m[i][h];
+      idct_1d(in, out);
+      for (int i = 0; i < 8; i++)
+        pixels[i][h] = vshrq_n_s32(add(out[i], col_round), col_shift);
+    }
+
+    // Saturating narrows clamp to 0-255 like CLAMP() does.
+    for (int r = 0; r < 8; r++)
+    {
+      int16x8_t row = vcombine_s16(vqmovn_s32(pixels[r][0]), vqmovn_s32(pixels[r][1]));
+      vst1_u8(pDst + r * 8, vqmovun_s16(row));
+    }
+  }
+
+  void ycc_rgb_h1_neon(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int h_blocks, int mcu_size)
+  {
+    for (int i = mcus; i > 0; i--)
+    {
+      for (int b = 0; b < h_blocks * 64; b += 64)
+      {
+        int16x8_t rc, gc, bc;
+        chroma_offsets(pCb + b, pCr + b, rc, gc, bc);
+
+        store_rgba(pDst0, load8(pY + b), rc, gc, bc);
+        pDst0 += 32;
+
+        if (pDst1)
+        {
+          store_rgba(pDst1, load8(pY + b + 8), rc, gc, bc);
+          pDst1 += 32;
+        }
+      }
+
+      pY += mcu_size;
+      pCb += mcu_size;
+      pCr += mcu_size;
+    }
+  }
+
+  void ycc_rgb_h2_neon(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int mcu_size)
+  {
+    for (int i = mcus; i > 0; i--)
+    {
+      int16x8_t rc, gc, bc;
+      chroma_offsets(pCb, pCr, rc, gc, bc);
+
+      // Each chroma sample twice: the first 4 samples cover the left Y block, the last 4 the right one.
+      const int16x8x2_t rc2 = vzipq_s16(rc, rc), gc2 = vzipq_s16(gc, gc), bc2 = vzipq_s16(bc, bc);
+
+      for (int b = 0; b < 2; b++)
+      {
+        store_rgba(pDst0, load8(pY + b * 64), rc2.val[b], gc2.val[b], bc2.val[b]);
+        pDst0 += 32;
+
+        if (pDst1)
+        {
+          store_rgba(pDst1, load8(pY + b * 64 + 8), rc2.val[b], gc2.val[b], bc2.val[b]);
+          pDst1 += 32;
+        }
+      }
+
+      pY += mcu_size;
+      pCb += mcu_size;
+      pCr += mcu_size;
+    }
+  }
+
+} // namespace jpgd
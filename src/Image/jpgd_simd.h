@@ -0,0 +1,67 @@
+// jpgd_simd.h - SIMD versions of the jpgd IDCT and YCbCr to RGB conversion.
+// These produce exactly the same output as the scalar idct() and colour converters in jpgd.cpp, which stays the reference, and the fallback for CPUs without these instructions.
+// Each version is in its own file, compiled with the instruction set flags it needs. jpgd.cpp picks the one to use at runtime.
+#ifndef JPGD_SIMD_H
+#define JPGD_SIMD_H
+
+#include "jpgd.h"
+
+namespace jpgd
+{
+  // Full 8x8 IDCT of a block of dequantized coefficients (in natural order) into 8x8 pixels, rows stored 8 bytes apart.
+  typedef void (*simd_idct_func)(const jpgd_block_t *pSrc, uint8 *pDst);
+
+  // YCbCr to RGBA of one scan line of mcus MCUs, with one chroma sample per pixel, h_blocks blocks wide per MCU.
+  // Block b of an MCU has its Y, Cb and Cr samples at pY, pCb and pCr + b * 64, and the next MCU is mcu_size bytes further.
+  // If pDst1 isn't NULL, the line 8 bytes below pY is converted into it as well, with the same chroma (V2 sampling).
+  typedef void (*simd_ycc_h1_func)(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int h_blocks, int mcu_size);
+
+  // YCbCr to RGBA like simd_ycc_h1_func, for H2 sampling: each MCU is two Y blocks wide, and each Cb and Cr sample is used for two pixels.
+  typedef void (*simd_ycc_h2_func)(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int mcu_size);
+
+  // Fixed point constants of the integer IDCT, the same as in jpgd.cpp.
+  enum
+  {
+    JPGD_IDCT_CONST_BITS = 13, JPGD_IDCT_PASS1_BITS = 2,
+    JPGD_FIX_0_298631336 = 2446, JPGD_FIX_0_390180644 = 3196, JPGD_FIX_0_541196100 = 4433, JPGD_FIX_0_765366865 = 6270,
+    JPGD_FIX_0_899976223 = 7373, JPGD_FIX_1_175875602 = 9633, JPGD_FIX_1_501321110 = 12299, JPGD_FIX_1_847759065 = 15137,
+    JPGD_FIX_1_961570560 = 16069, JPGD_FIX_2_053119869 = 16819, JPGD_FIX_2_562915447 = 20995, JPGD_FIX_3_072711026 = 25172
+  };
+
+  // The YCbCr to RGB factors of create_look_ups() in jpgd.cpp, in 16.16 fixed point, reduced by a multiple of 65536 so they fit in 16 bits:
+  // R = Y + Cr + ((JPGD_YCC_CR_R * Cr + 32768) >> 16), G = Y - Cr + ((JPGD_YCC_CR_G * Cr + JPGD_YCC_CB_G * Cb + 32768) >> 16),
+  // B = Y + 2 * Cb + ((JPGD_YCC_CB_B * Cb + 32768) >> 16), with Cb and Cr centered on 0.
+  enum
+  {
+    JPGD_YCC_CR_R = 91881 - 65536, JPGD_YCC_CR_G = -46802 + 65536, JPGD_YCC_CB_G = -22554, JPGD_YCC_CB_B = 116130 - 2 * 65536
+  };
+
+  // The SIMD instruction sets there are kernels for, best one first.
+  enum simd_support { SIMD_AVX2, SIMD_SSE2, SIMD_NEON, SIMD_NONE };
+
+  // The best instruction set the CPU supports, detected on the first call.
+  simd_support get_simd_support();
+
+  // The IDCT used by the decoder, block_max_zag is the number of coefficients in zig-zag order that can be non-zero.
+  // It uses the SIMD kernel when there is one, and is the scalar reference when SIMD is disabled.
+  void idct(const jpgd_block_t *pSrc_ptr, uint8 *pDst_ptr, int block_max_zag);
+
+  // Use the fastest kernels the CPU supports (the default), or only the scalar code. Meant for comparing the two in tests and benchmarks,
+  // don't call it while anything is being decoded.
+  void set_simd_enabled(bool enabled);
+
+#if defined(JPGD_SIMD_X86)
+  void idct_sse2(const jpgd_block_t *pSrc, uint8 *pDst);
+  void idct_avx2(const jpgd_block_t *pSrc, uint8 *pDst);
+  void ycc_rgb_h1_sse2(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int h_blocks, int mcu_size);
+  void ycc_rgb_h2_sse2(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int mcu_size);
+#endif
+#if defined(JPGD_SIMD_NEON)
+  void idct_neon(const jpgd_block_t *pSrc, uint8 *pDst);
+  void ycc_rgb_h1_neon(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int h_blocks, int mcu_size);
+  void ycc_rgb_h2_neon(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int mcu_size);
+#endif
+
+} // namespace jpgd
+
+#endif // JPGD_SIMD_H
@@ -0,0 +1,231 @@
+// jpgd_sse2.cpp - SSE2 versions of the jpgd IDCT and colour conversion, see jpgd_simd.h.
+// Compiled with -msse2. The IDCT works on 4 rows or columns at a time, in 32-bit lanes, so all intermediate values are exactly those of the scalar version.
+// The colour conversion works on 8 pixels at a time.
+#include "jpgd_simd.h"
+
+#include <emmintrin.h>
+
+namespace jpgd
+{
+  namespace
+  {
+    // Low 32 bits of a * c in each lane. SSE2 has no 32-bit multiply, so this multiplies the even and odd lanes separately into 64 bits.
+    inline __m128i mul(__m128i a, int32 c)
+    {
+      const __m128i k = _mm_set1_epi32(c);
+      __m128i even = _mm_mul_epu32(a, k);
+      __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), k);
+      return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    inline __m128i add(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+    inline __m128i sub(__m128i a, __m128i b) { return _mm_sub_epi32(a, b); }
+
+    // The same operations as Row<8>::idct() and Col<8>::idct() in jpgd.cpp, up to the descaling.
+    inline void idct_1d(const __m128i *in, __m128i *out)
+    {
+      const __m128i z2 = in[2], z3 = in[6];
+
+      const __m128i z1 = mul(add(z2, z3), JPGD_FIX_0_541196100);
+      const __m128i tmp2 = add(z1, mul(z3, -JPGD_FIX_1_847759065));
+      const __m128i tmp3 = add(z1, mul(z2, JPGD_FIX_0_765366865));
+
+      const __m128i tmp0 = _mm_slli_epi32(add(in[0], in[4]), JPGD_IDCT_CONST_BITS);
+      const __m128i tmp1 = _mm_slli_epi32(sub(in[0], in[4]), JPGD_IDCT_CONST_BITS);
+
+      const __m128i tmp10 = add(tmp0, tmp3), tmp13 = sub(tmp0, tmp3), tmp11 = add(tmp1, tmp2), tmp12 = sub(tmp1, tmp2);
+
+      const __m128i atmp0 = in[7], atmp1 = in[5], atmp2 = in[3], atmp3 = in[1];
+
+      const __m128i bz1 = add(atmp0, atmp3), bz2 = add(atmp1, atmp2), bz3 = add(atmp0, atmp2), bz4 = add(atmp1, atmp3);
+      const __m128i bz5 = mul(add(bz3, bz4), JPGD_FIX_1_175875602);
+
+      const __m128i az1 = mul(bz1, -JPGD_FIX_0_899976223);
+      const __m128i az2 = mul(bz2, -JPGD_FIX_2_562915447);
+      const __m128i az3 = add(mul(bz3, -JPGD_FIX_1_961570560), bz5);
+      const __m128i az4 = add(mul(bz4, -JPGD_FIX_0_390180644), bz5);
+
+      const __m128i btmp0 = add(add(mul(atmp0, JPGD_FIX_0_298631336), az1), az3);
+      const __m128i btmp1 = add(add(mul(atmp1, JPGD_FIX_2_053119869), az2), az4);
+      const __m128i btmp2 = add(add(mul(atmp2, JPGD_FIX_3_072711026), az2), az3);
+      const __m128i btmp3 = add(add(mul(atmp3, JPGD_FIX_1_501321110), az1), az4);
+
+      out[0] = add(tmp10, btmp3);
+      out[7] = sub(tmp10, btmp3);
+      out[1] = add(tmp11, btmp2);
+      out[6] = sub(tmp11, btmp2);
+      out[2] = add(tmp12, btmp1);
+      out[5] = sub(tmp12, btmp1);
+      out[3] = add(tmp13, btmp0);
+      out[4] = sub(tmp13, btmp0);
+    }
+
+    inline void transpose4x4(__m128i &r0, __m128i &r1, __m128i &r2, __m128i &r3)
+    {
+      __m128i t0 = _mm_unpacklo_epi32(r0, r1), t1 = _mm_unpackhi_epi32(r0, r1);
+      __m128i t2 = _mm_unpacklo_epi32(r2, r3), t3 = _mm_unpackhi_epi32(r2, r3);
+      r0 = _mm_unpacklo_epi64(t0, t2);
+      r1 = _mm_unpackhi_epi64(t0, t2);
+      r2 = _mm_unpacklo_epi64(t1, t3);
+      r3 = _mm_unpackhi_epi64(t1, t3);
+    }
+
+    // Transposes an 8x8 matrix stored as m[row][half], where half 0 holds columns 0-3 and half 1 columns 4-7, into t[column][half].
+    inline void transpose8x8(__m128i m[8][2], __m128i t[8][2])
+    {
+      for (int hr = 0; hr < 2; hr++)
+      {
+        for (int hc = 0; hc < 2; hc++)
+        {
+          __m128i r0 = m[hr * 4 + 0][hc], r1 = m[hr * 4 + 1][hc], r2 = m[hr * 4 + 2][hc], r3 = m[hr * 4 + 3][hc];
+          transpose4x4(r0, r1, r2, r3);
+          t[hc * 4 + 0][hr] = r0;
+          t[hc * 4 + 1][hr] = r1;
+          t[hc * 4 + 2][hr] = r2;
+          t[hc * 4 + 3][hr] = r3;
+        }
+      }
+    }
+
+    // (a * ca + b * cb + 32768) >> 16 for 8 signed 16-bit lanes.
+    inline __m128i madd_descale(__m128i a, __m128i b, int16 ca, int16 cb)
+    {
+      const __m128i c = _mm_set1_epi32((int32)((uint16)ca | ((uint)(uint16)cb << 16)));
+      const __m128i round = _mm_set1_epi32(32768);
+      __m128i lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), c), round), 16);
+      __m128i hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), c), round), 16);
+      return _mm_packs_epi32(lo, hi);
+    }
+
+    // 8 samples widened to 16 bits.
+    inline __m128i load8(const uint8 *p)
+    {
+      return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), _mm_setzero_si128());
+    }
+
+    // The values m_crr[cr], (m_crg[cr] + m_cbg[cb]) >> 16 and m_cbb[cb] give for 8 chroma samples.
+    inline void chroma_offsets(const uint8 *pCb, const uint8 *pCr, __m128i &rc, __m128i &gc, __m128i &bc)
+    {
+      const __m128i center = _mm_set1_epi16(128), zero = _mm_setzero_si128();
+      const __m128i cb = _mm_sub_epi16(load8(pCb), center);
+      const __m128i cr = _mm_sub_epi16(load8(pCr), center);
+
+      rc = _mm_add_epi16(cr, madd_descale(cr, zero, JPGD_YCC_CR_R, 0));
+      gc = _mm_sub_epi16(madd_descale(cr, cb, JPGD_YCC_CR_G, JPGD_YCC_CB_G), cr);
+      bc = _mm_add_epi16(_mm_add_epi16(cb, cb), madd_descale(cb, zero, JPGD_YCC_CB_B, 0));
+    }
+
+    // Stores 8 RGBA pixels. The saturating packs clamp to 0-255 like clamp() does.
+    inline void store_rgba(uint8 *pDst, __m128i y, __m128i rc, __m128i gc, __m128i bc)
+    {
+      const __m128i rg = _mm_packus_epi16(_mm_add_epi16(y, rc), _mm_add_epi16(y, gc));
+      const __m128i ba = _mm_packus_epi16(_mm_add_epi16(y, bc), _mm_set1_epi16(255));
+      const __m128i rg_pairs = _mm_unpacklo_epi8(rg, _mm_srli_si128(rg, 8));
+      const __m128i ba_pairs = _mm_unpacklo_epi8(ba, _mm_srli_si128(ba, 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst), _mm_unpacklo_epi16(rg_pairs, ba_pairs));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + 16), _mm_unpackhi_epi16(rg_pairs, ba_pairs));
+    }
+  }
+
+  void idct_sse2(const jpgd_block_t *pSrc, uint8 *pDst)
+  {
+    __m128i m[8][2], t[8][2], in[8], out[8];
+
+    for (int r = 0; r < 8; r++)
+    {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pSrc + r * 8));
+      m[r][0] = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+      m[r][1] = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+    }
+
+    // Rows, each lane is one row of the block.
+    transpose8x8(m, t);
+    const __m128i row_round = _mm_set1_epi32(1 << (JPGD_IDCT_CONST_BITS - JPGD_IDCT_PASS1_BITS - 1));
+    for (int h = 0; h < 2; h++)
+    {
+      for (int i = 0; i < 8; i++)
+        in[i] = t[i][h];
+      idct_1d(in, out);
+      for (int i = 0; i < 8; i++)
+        t[i][h] = _mm_srai_epi32(add(out[i], row_round), JPGD_IDCT_CONST_BITS - JPGD_IDCT_PASS1_BITS);
+    }
+
+    // Columns, each lane is one column of the block.
+    transpose8x8(t, m);
+    const int col_shift = JPGD_IDCT_CONST_BITS + JPGD_IDCT_PASS1_BITS + 3;
+    const __m128i col_round = _mm_set1_epi32((128 << col_shift) + (1 << (col_shift - 1)));
+    __m128i pixels[8][2];
+    for (int h = 0; h < 2; h++)
+    {
+      for (int i = 0; i < 8; i++)
+        in[i] = m[i][h];
+      idct_1d(in, out);
+      for (int i = 0; i < 8; i++)
+        pixels[i][h] = _mm_srai_epi32(add(out[i], col_round), col_shift);
+    }
+
+    // Saturating packs clamp to 0-255 like CLAMP() does.
+    for (int r = 0; r < 8; r += 2)
+    {
+      __m128i row0 = _mm_packs_epi32(pixels[r][0], pixels[r][1]);
+      __m128i row1 = _mm_packs_epi32(pixels[r + 1][0], pixels[r + 1][1]);
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(pDst + r * 8), _mm_packus_epi16(row0, row1));
+    }
+  }
+
+  void ycc_rgb_h1_sse2(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int h_blocks, int mcu_size)
+  {
+    for (int i = mcus; i > 0; i--)
+    {
+      for (int b = 0; b < h_blocks * 64; b += 64)
+      {
+        __m128i rc, gc, bc;
+        chroma_offsets(pCb + b, pCr + b, rc, gc, bc);
+
+        store_rgba(pDst0, load8(pY + b), rc, gc, bc);
+        pDst0 += 32;
+
+        if (pDst1)
+        {
+          store_rgba(pDst1, load8(pY + b + 8), rc, gc, bc);
+          pDst1 += 32;
+        }
+      }
+
+      pY += mcu_size;
+      pCb += mcu_size;
+      pCr += mcu_size;
+    }
+  }
+
+  void ycc_rgb_h2_sse2(const uint8 *pY, const uint8 *pCb, const uint8 *pCr, uint8 *pDst0, uint8 *pDst1, int mcus, int mcu_size)
+  {
+    for (int i = mcus; i > 0; i--)
+    {
+      __m128i rc, gc, bc;
+      chroma_offsets(pCb, pCr, rc, gc, bc);
+
+      // Each chroma sample twice: the first 4 samples cover the left Y block, the last 4 the right one.
+      const __m128i rc2[2] = { _mm_unpacklo_epi16(rc, rc), _mm_unpackhi_epi16(rc, rc) };
+      const __m128i gc2[2] = { _mm_unpacklo_epi16(gc, gc), _mm_unpackhi_epi16(gc, gc) };
+      const __m128i bc2[2] = { _mm_unpacklo_epi16(bc, bc), _mm_unpackhi_epi16(bc, bc) };
+
+      for (int b = 0; b < 2; b++)
+      {
+        store_rgba(pDst0, load8(pY + b * 64), rc2[b], gc2[b], bc2[b]);
+        pDst0 += 32;
+
+        if (pDst1)
+        {
+          store_rgba(pDst1, load8(pY + b * 64 + 8), rc2[b], gc2[b], bc2[b]);
+          pDst1 += 32;
+        }
+      }
+
+      pY += mcu_size;
+      pCb += mcu_size;
+      pCr += mcu_size;
+    }
+  }
+
+} // namespace jpgd
@@ -0,0 +1,62 @@
+#include "JpegPushStream.h"
+
+#include <string.h>
+
+JpegPushStream::JpegPushStream(FrameBuffer& frame)
+: frame(frame), read_position(0), finished(true)
+{
+}
+
+void JpegPushStream::begin()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    frame.clear();
+    read_position = 0;
+    finished = false;
+}
+
+void JpegPushStream::push(const char* data, size_t size)
+{
+    {
+        // The frame may be re-allocated when it grows, so it's only accessed with the lock held, also when reading.
+        std::lock_guard<std::mutex> lock(mutex);
+        frame.append(data, size);
+    }
+    data_available.notify_one();
+}
+
+void JpegPushStream::finish()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    }
+    data_available.notify_one();
+}
+
+int JpegPushStream::read(jpgd::uint8* buffer, int max_bytes_to_read, bool* eof_flag)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    data_available.wait(lock, [this] { return finished || read_position < frame.getSize(); });
+
+    size_t size = frame.getSize() - read_position;
+    if (size > static_cast<size_t>(max_bytes_to_read))
+    {
+        size = max_bytes_to_read;
+    }
+    memcpy(buffer, frame.getData() + read_position, size);
+    read_position += size;
+    *eof_flag = finished && read_position == frame.getSize();
+    return static_cast<int>(size);
+}
+
+size_t JpegPushStream::curlWrite(char* data, size_t size, size_t nmemb, JpegPushStream* stream)
+{
+    return FrameBuffer::curlReceive(size * nmemb, [&]() { stream->push(data, size * nmemb); });
+}
+
+size_t JpegPushStream::curlHeader(char* data, size_t size, size_t nmemb, JpegPushStream* stream)
+{
+    std::lock_guard<std::mutex> lock(stream->mutex);
+    return FrameBuffer::curlHeader(data, size, nmemb, &stream->frame);
+}
@@ -0,0 +1,56 @@
+#ifndef JPEG_PUSH_STREAM_H
+#define JPEG_PUSH_STREAM_H
+
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+
+#include "FrameBuffer.h"
+#include "Image/jpgd.h"
+
+/** Stream that lets the JPEG decoder read a frame while it is still being received.
+ *  The receiving thread pushes the data as it arrives, it is stored in the frame buffer.
+ *  The decoder reads it on another thread, and waits in read() when it gets ahead of the received data.
+ *  The frame buffer should only be used through the stream between begin() and finish().
+ */
+class JpegPushStream : public jpgd::jpeg_decoder_stream, NoCopy
+{
+public:
+    /** Create a stream that stores the received data in the given frame.
+     */
+    JpegPushStream(FrameBuffer& frame);
+
+    /** Start receiving a new frame. The frame buffer is cleared, and the decoder reads from its start again.
+     *  Must be called before the decoder starts reading.
+     */
+    void begin();
+
+    /** Add received data to the frame, and wake up the decoder when it was waiting for it.
+     */
+    void push(const char* data, size_t size);
+
+    /** Mark the end of the frame, either because it was received completely or because the transfer failed.
+     *  The decoder gets the end of the stream after the data that was pushed.
+     */
+    void finish();
+
+    virtual int read(jpgd::uint8* buffer, int max_bytes_to_read, bool* eof_flag);
+
+    /** Function for the libcurl write callback, pushes the received data into the stream.
+     */
+    static size_t curlWrite(char* data, size_t size, size_t nmemb, JpegPushStream* stream);
+
+    /** Function for the libcurl header callback, reserves room in the frame like FrameBuffer::curlHeader().
+     */
+    static size_t curlHeader(char* data, size_t size, size_t nmemb, JpegPushStream* stream);
+private:
+    FrameBuffer& frame;
+    // Position of the next byte that the decoder reads from the frame.
+    size_t read_position;
+    bool finished;
+
+    std::mutex mutex;
+    std::condition_variable data_available;
+};
+
+#endif //JPEG_PUSH_STREAM_H
@@ -1,30 +1,92 @@
 #include <iostream>
-#include <unistd.h>
+#include <stdlib.h>
 
-#include "System/Clock.h"
+#include "System/EventLoop.h"
 
 #include "DBus/DBus.h"
+#include "DBus/DBusPrinter.h"
 
-#include "QRDetector.h"
+#include "ScanEngine.h"
+#include "ScanPipeline.h"
+
+// Printer procedures that wait for a code to be shown to a camera, the cameras are scanned at their full rate while they run.
+static const char* const SCAN_PROCEDURES[] = {"LOAD_MATERIAL", "CHANGE_MATERIAL"};
+
+// Follow the printer procedures, and let the rate controller pick up the ones that are running already.
+static void watchProcedures(ScanRateController& rate_controller)
+{
+    // Without the printer service there is nothing to tell when a code is expected, so the cameras keep their configured rate.
+    if (!DBus::Bus::getInstance()->isConnected())
+    {
+        std::cout << "No DBus connection, scanning at a fixed rate" << std::endl;
+        rate_controller.setIdleInterval(0);
+        return;
+    }
+    for (const char* procedure : SCAN_PROCEDURES)
+    {
+        rate_controller.watchProcedure(procedure);
+    }
+    DBusPrinter::getInstance()->updateInitialActiveProcedures();
+}
+
+// Scan all cameras in a configuration file, see CameraConfig::load() for its format.
+static int scanCameras(const std::string& filename)
+{
+    std::vector<CameraConfig> configs;
+    if (!CameraConfig::load(filename, configs))
+    {
+        return 1;
+    }
+    EventLoop loop;
+    ScanEngine engine(loop);
+    for (const CameraConfig& config : configs)
+    {
+        engine.addCamera(config);
+    }
+    engine.setResultCallback([](const std::string& name, const std::string& text)
+    {
+        std::cout << name << ": " << text << std::endl;
+    });
+    watchProcedures(engine.getRateController());
+    engine.start();
+    DBus::Bus::getInstance()->attach(loop);
+    loop.run();
+    return 0;
+}
 
 int main(int argc, char** argv)
 {
-    Clock elapsed_time;
-    QRDetector detector("http://10.180.1.150:8080/?action=snapshot");
-
-    while(true)
-    {
-        if( elapsed_time.getMilliseconds() < 500)
-        {
-            usleep(5 * 1000);
-            continue;
-        } else
-        {
-            elapsed_time.reset();
-        }
-        std::cout << detector.detect() << std::endl;
-        //DBus::Bus::getInstance()->update();
+    std::string url = "http://10.180.1.150:8080/?action=snapshot";
+    if (argc > 1)
+    {
+        url = argv[1];
     }
+    // Anything that is not an URL is a file with the cameras to scan.
+    if (url.find("://") == std::string::npos)
+    {
+        return scanCameras(url);
+    }
+    // Fetching, decoding and searching run at the same time, on consecutive frames.
+    EventLoop loop;
+    ScanPipeline pipeline(loop, url, [](const std::string& text)
+    {
+        std::cout << text << std::endl;
+    });
+    // Optionally search a reduced size image first (2, 4 or 8), for setups where the code covers a large part of the image.
+    if (argc > 2 && !pipeline.setCoarseScale(atoi(argv[2])))
+    {
+        std::cout << "Coarse scale must be 1, 2, 4 or 8" << std::endl;
+        return 1;
+    }
+    // Frames with restart intervals are decoded on this many threads, by default one per CPU core.
+    pipeline.setDecodeThreads(argc > 3 ? atoi(argv[3]) : 0);
+    pipeline.start();
+    // The camera only runs at its full rate while a procedure waits for a code, or shortly after it saw something change.
+    watchProcedures(pipeline.getRateController());
+
+    // Everything happens in callbacks from here on, the loop sleeps until a camera or the DBus connection has something to handle.
+    DBus::Bus::getInstance()->attach(loop);
+    loop.run();
     return 0;
 }
 
@@ -0,0 +1,115 @@
+#include "MjpegStream.h"
+#include <curl/curl.h>
+
+#include <chrono>
+#include <iostream>
+
+// How long grab() waits for the next frame before giving up.
+static const int GRAB_TIMEOUT_MS = 5000;
+// How long to wait before re-opening the stream after it failed.
+static const int RECONNECT_DELAY_MS = 1000;
+
+MjpegStream::MjpegStream(std::string url)
+: url(url), parser([this](FrameBuffer& part) { onFrame(part); }), running(true), received_new_frame(false)
+{
+    curl = curl_easy_init();
+    if(!curl)
+    {
+        throw std::string("Unable to initialize curl");
+    }
+    curl_easy_setopt(curl, CURLOPT_URL, this->url.c_str());
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &MjpegStream::curlWrite);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &MjpegStream::curlHeader);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
+    // The progress function is also called when no data arrives, which allows the destructor to stop a stalled stream.
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, &MjpegStream::curlProgress);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, this);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, 2000L);
+    // A stream that stops sending data is considered dead, and will be re-opened.
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+    curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, 5L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_FAILONERROR, 1L);
+
+    thread = std::thread(&MjpegStream::run, this);
+}
+
+MjpegStream::~MjpegStream()
+{
+    running = false;
+    thread.join();
+    curl_easy_cleanup(curl);
+}
+
+void MjpegStream::run()
+{
+    while(running)
+    {
+        parser.reset();
+        CURLcode result = curl_easy_perform(curl);
+        if (!running)
+        {
+            break;
+        }
+        std::cout << "MJPEG stream ended: " << curl_easy_strerror(result) << std::endl;
+        std::this_thread::sleep_for(std::chrono::milliseconds(RECONNECT_DELAY_MS));
+    }
+}
+
+bool MjpegStream::grab()
+{
+    std::unique_lock<std::mutex> lock(frame_mutex);
+    if (!frame_condition.wait_for(lock, std::chrono::milliseconds(GRAB_TIMEOUT_MS), [this]() { return received_new_frame; }))
+    {
+        return false;
+    }
+    // Swap instead of copy, the old buffer of the frame is re-used to receive a next one.
+    frame.swap(received_frame);
+    received_new_frame = false;
+    return true;
+}
+
+FrameBuffer& MjpegStream::getFrame()
+{
+    return frame;
+}
+
+void MjpegStream::onFrame(FrameBuffer& part)
+{
+    {
+        std::lock_guard<std::mutex> lock(frame_mutex);
+        received_frame.swap(part);
+        received_new_frame = true;
+    }
+    frame_condition.notify_one();
+}
+
+size_t MjpegStream::curlWrite(char* data, size_t size, size_t nmemb, MjpegStream* stream)
+{
+    if (!stream->running)
+    {
+        // Returning less than the received size aborts the transfer.
+        return 0;
+    }
+    return FrameBuffer::curlReceive(size * nmemb, [&]() { stream->parser.feed(data, size * nmemb); });
+}
+
+size_t MjpegStream::curlHeader(char* data, size_t size, size_t nmemb, MjpegStream* stream)
+{
+    std::string line(data, size * nmemb);
+    std::string boundary = MultipartParser::parseBoundary(line);
+    if (!boundary.empty())
+    {
+        stream->parser.setBoundary(boundary);
+    }
+    return size * nmemb;
+}
+
+int MjpegStream::curlProgress(MjpegStream* stream, int64_t dltotal, int64_t dlnow, int64_t ultotal, int64_t ulnow)
+{
+    // Non-zero aborts the transfer.
+    return stream->running ? 0 : 1;
+}
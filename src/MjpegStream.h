@@ -0,0 +1,67 @@
+#ifndef MJPEG_STREAM_H
+#define MJPEG_STREAM_H
+
+#include <atomic>
+#include <stdint.h>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "FrameSource.h"
+#include "MultipartParser.h"
+
+// CURL is a c lib, so this is the 'forward declaration'
+typedef void CURL;
+
+/** The MjpegStream receives frames from a mjpg-streamer "?action=stream" URL.
+ *  The stream is opened once, and received on a background thread, which splits the multipart body into JPEG frames as the bytes arrive.
+ *  grab() hands out the newest complete frame, older frames that were not grabbed in time are dropped.
+ *  Frames are never copied: the parser, the receive thread and grab() swap their buffers.
+ *  If the connection is lost, the stream is re-opened automatically.
+ */
+class MjpegStream : public FrameSource
+{
+public:
+    /** Open the stream on the given URL.
+     * /param url URL of the stream.
+     */
+    MjpegStream(std::string url);
+    ~MjpegStream();
+
+    /** Wait for a frame that was not grabbed before.
+     * /returns true if a new frame is available, false if no frame arrived within the timeout.
+     */
+    virtual bool grab();
+
+    /** Get the last grabbed frame.
+     *  The frame is only valid until the next call to grab().
+     */
+    virtual FrameBuffer& getFrame();
+
+    /** Functions required for the libcurl to hand us the received data and headers.
+     */
+    static size_t curlWrite(char* data, size_t size, size_t nmemb, MjpegStream* stream);
+    static size_t curlHeader(char* data, size_t size, size_t nmemb, MjpegStream* stream);
+    static int curlProgress(MjpegStream* stream, int64_t dltotal, int64_t dlnow, int64_t ultotal, int64_t ulnow);
+protected:
+    std::string url;
+    CURL* curl;
+    MultipartParser parser;
+
+    std::atomic<bool> running;
+    std::thread thread;
+
+    std::mutex frame_mutex;
+    std::condition_variable frame_condition;
+    // Newest complete frame, filled by the receive thread.
+    FrameBuffer received_frame;
+    bool received_new_frame;
+    // Frame handed out by grab(), only used from the thread that calls grab().
+    FrameBuffer frame;
+
+    void run();
+    void onFrame(FrameBuffer& part);
+};
+
+#endif //MJPEG_STREAM_H
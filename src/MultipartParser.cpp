@@ -0,0 +1,172 @@
+#include "MultipartParser.h"
+
+#include <stdlib.h>
+#include <strings.h>
+#include <algorithm>
+
+// Headers of a part are never this big. If we get more without finding the end of the headers we are not looking at a multipart stream.
+static const size_t MAX_HEADER_SIZE = 4096;
+// Parts without a Content-Length that grow beyond this size are thrown away, so a missing boundary cannot eat all memory.
+// A larger Content-Length is not believed, the part is split at the boundary instead.
+static const size_t MAX_PART_SIZE = FrameBuffer::MAX_FRAME_SIZE;
+
+MultipartParser::MultipartParser(part_callback_t callback): callback(callback)
+{
+    reset();
+}
+
+void MultipartParser::setBoundary(std::string boundary)
+{
+    // Built once, it's searched for in every chunk of body data.
+    delimiter = boundary.empty() ? "" : "\r\n--" + boundary;
+}
+
+void MultipartParser::reset()
+{
+    headers.clear();
+    part.clear();
+    state = Headers;
+    content_length = -1;
+}
+
+void MultipartParser::feed(const char* data, size_t size)
+{
+    while(size > 0)
+    {
+        size_t used;
+        if (state == Headers)
+        {
+            used = feedHeaders(data, size);
+        } else
+        {
+            used = feedBody(data, size);
+        }
+        data += used;
+        size -= used;
+    }
+}
+
+size_t MultipartParser::feedHeaders(const char* data, size_t size)
+{
+    // The end of the headers can be split over two chunks, so also search the last bytes we already have.
+    size_t search_start = headers.size() < 3 ? 0 : headers.size() - 3;
+    size_t old_size = headers.size();
+    headers.append(data, size);
+
+    size_t end = headers.find("\r\n\r\n", search_start);
+    if (end == std::string::npos)
+    {
+        if (headers.size() > MAX_HEADER_SIZE)
+        {
+            // Garbage, keep only the tail as it could contain the start of the next header.
+            headers.erase(0, headers.size() - 3);
+        }
+        return size;
+    }
+
+    parseHeaders(end);
+    headers.clear();
+    state = Body;
+    part.clear();
+    if (content_length > static_cast<long>(MAX_PART_SIZE))
+    {
+        content_length = -1;
+    }
+    if (content_length > 0)
+    {
+        part.reserve(content_length);
+    }
+    // Anything after the end of the headers is body data.
+    return end + 4 - old_size;
+}
+
+void MultipartParser::parseHeaders(size_t end)
+{
+    // The header block also contains the boundary line (and the CRLF in front of it), these are simply skipped.
+    content_length = -1;
+    size_t line_start = 0;
+    while(line_start < end)
+    {
+        size_t line_end = headers.find("\r\n", line_start);
+        if (line_end == std::string::npos || line_end > end)
+        {
+            line_end = end;
+        }
+        static const char content_length_header[] = "Content-Length:";
+        if (strncasecmp(headers.c_str() + line_start, content_length_header, sizeof(content_length_header) - 1) == 0)
+        {
+            content_length = strtol(headers.c_str() + line_start + sizeof(content_length_header) - 1, nullptr, 10);
+        }
+        line_start = line_end + 2;
+    }
+}
+
+size_t MultipartParser::feedBody(const char* data, size_t size)
+{
+    if (content_length >= 0)
+    {
+        size_t used = std::min(size, static_cast<size_t>(content_length) - part.getSize());
+        part.append(data, used);
+        if (part.getSize() == static_cast<size_t>(content_length))
+        {
+            finishPart();
+        }
+        return used;
+    }
+
+    if (delimiter.empty() || part.getSize() + size > MAX_PART_SIZE)
+    {
+        // Without a length and without a boundary there is no way to find the end of the part.
+        part.clear();
+        return size;
+    }
+
+    // The delimiter can be split over two chunks, so also search the last bytes we already have.
+    size_t old_size = part.getSize();
+    size_t search_start = old_size < delimiter.size() ? 0 : old_size - delimiter.size() + 1;
+    part.append(data, size);
+
+    const char* begin = reinterpret_cast<const char*>(part.getData());
+    const char* end = begin + part.getSize();
+    const char* found = std::search(begin + search_start, end, delimiter.begin(), delimiter.end());
+    if (found == end)
+    {
+        return size;
+    }
+
+    // The boundary line and whatever follows it belongs to the next part, and is fed again from where it is, without copying it.
+    // When the delimiter started in an earlier chunk, that start is no longer in the data, but it's the same as in our own delimiter.
+    size_t boundary_start = found + 2 - begin;
+    part.truncate(found - begin);
+    finishPart();
+    if (boundary_start < old_size)
+    {
+        feed(delimiter.data() + 2, old_size - boundary_start);
+        return 0;
+    }
+    return boundary_start - old_size;
+}
+
+void MultipartParser::finishPart()
+{
+    callback(part);
+    part.clear();
+    state = Headers;
+}
+
+std::string MultipartParser::parseBoundary(const std::string& header_line)
+{
+    size_t start = header_line.find("boundary=");
+    if (start == std::string::npos)
+    {
+        return "";
+    }
+    start += 9;
+    size_t end = header_line.find_first_of("; \r\n", start);
+    std::string result = header_line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    if (result.size() >= 2 && result[0] == '"' && result[result.size() - 1] == '"')
+    {
+        result = result.substr(1, result.size() - 2);
+    }
+    return result;
+}
@@ -0,0 +1,64 @@
+#ifndef MULTIPART_PARSER_H
+#define MULTIPART_PARSER_H
+
+#include <functional>
+#include <string>
+
+#include "FrameBuffer.h"
+
+/** Splits a multipart/x-mixed-replace body (as send by mjpg-streamer "?action=stream") into its parts.
+ *  Data can be fed in chunks of any size, as it arrives from the network. Each time a part is complete the callback is called with its body.
+ *  The body of a part is written directly into a FrameBuffer, which is reserved up front when the part has a Content-Length header.
+ *  Without a Content-Length header the part ends at the next boundary.
+ *  The parser does no network I/O by itself, so it can be fed from a recorded stream as well.
+ */
+class MultipartParser
+{
+public:
+    typedef std::function<void(FrameBuffer& part)> part_callback_t;
+
+    /** Create a parser that calls the callback for each complete part.
+     * /param callback function that receives the body of each part.
+     *        The callback may swap the contents of the part with another FrameBuffer, the parser clears the part and re-uses it for the next part.
+     */
+    MultipartParser(part_callback_t callback);
+
+    /** Set the boundary string, without the leading "--". Only needed for parts without a Content-Length header.
+     *  Can be taken from the boundary parameter of the Content-Type header of the HTTP response.
+     */
+    void setBoundary(std::string boundary);
+
+    /** Feed received bytes to the parser.
+     */
+    void feed(const char* data, size_t size);
+
+    /** Throw away any partial part, for example after a reconnect.
+     */
+    void reset();
+
+    /** Get the boundary from a "Content-Type: multipart/x-mixed-replace;boundary=..." header line.
+     * /returns the boundary, or an empty string if the line has no boundary.
+     */
+    static std::string parseBoundary(const std::string& header_line);
+private:
+    enum State
+    {
+        Headers,
+        Body
+    };
+
+    part_callback_t callback;
+    // The boundary with the CRLF and "--" in front of it, as it appears between two parts.
+    std::string delimiter;
+    std::string headers;
+    FrameBuffer part;
+    State state;
+    long content_length;
+
+    size_t feedHeaders(const char* data, size_t size);
+    size_t feedBody(const char* data, size_t size);
+    void parseHeaders(size_t end);
+    void finishPart();
+};
+
+#endif //MULTIPART_PARSER_H
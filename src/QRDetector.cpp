@@ -1,52 +1,447 @@
 #include "QRDetector.h"
-#include "CurlRequest.h"
 
-#include "Image/jpgd.h" //Required for decompress_jpeg_image_from_memory
+#include "Image/jpgd.h" //Required for decompress_jpeg_image_from_stream
 #include "Image/ImageReaderSource.h"
+#include "Image/JpegInfo.h"
+#include "Image/LuminanceView.h"
+#include "System/ThreadPool.h"
 
 #include <zxing/qrcode/QRCodeReader.h>
 #include <zxing/common/HybridBinarizer.h>
 #include <zxing/BinaryBitmap.h>
 #include <zxing/MultiFormatReader.h>
 #include <zxing/ReaderException.h>
+#include <zxing/NotFoundException.h>
 
 #include <iostream>
 
-QRDetector::QRDetector(std::string url): url(url)
+namespace
+{
+    // Runs the restart intervals of a frame on the ThreadPool.
+    class ThreadPoolExecutor : public jpgd::jpeg_decoder_executor
+    {
+    public:
+        ThreadPoolExecutor(ThreadPool& pool) : pool(pool) {}
+
+        virtual int get_num_threads()
+        {
+            return pool.getThreadCount();
+        }
+
+        virtual void run(void (*task)(void* data, int index), void* data, int count)
+        {
+            pool.run([task, data](int index) { task(data, index); }, count);
+        }
+    private:
+        ThreadPool& pool;
+    };
+}
+
+QRDetector::QRDetector(std::string url): frame_source(FrameSource::create(url)), frame_width(0), frame_height(0), coarse_scale(1), roi_x(0), roi_y(0), roi_width(0), roi_height(0)
+{
+    setDecodeHints(zxing::DecodeHints::QR_CODE_HINT);
+}
+
+QRDetector::QRDetector(): frame_width(0), frame_height(0), coarse_scale(1), roi_x(0), roi_y(0), roi_width(0), roi_height(0)
+{
+    setDecodeHints(zxing::DecodeHints::QR_CODE_HINT);
+}
+
+QRDetector::~QRDetector()
 {}
 
 std::string QRDetector::detect()
 {
-    CurlRequest camera_request(url);
+    // When the source can deliver the frame while it is being received, the decoding overlaps with the transfer.
+    jpgd::jpeg_decoder_stream* incoming = frame_source->startGrab();
+    if (incoming)
+    {
+        return detectIncoming(*incoming);
+    }
 
-    int width = 800;
-    int height = 600;
-    int size = 800 * 600 * 3;
-    int comps = 0;
+    if (!frame_source->grab())
+    {
+        std::cout << "Unable to grab frame" << std::endl;
+        return "";
+    }
+    return detectFrame(frame_source->getFrame());
+}
 
-    zxing::DecodeHints hints(zxing::DecodeHints::DEFAULT_HINT);
-    zxing::Ref<zxing::Reader> reader(new zxing::MultiFormatReader);
-    zxing::Ref<zxing::Result> result;
+std::string QRDetector::detectFrame(FrameBuffer& frame)
+{
+    bool changed;
+    return detectFrame(frame, changed);
+}
+
+std::string QRDetector::detectFrame(FrameBuffer& frame, bool& changed)
+{
+    changed = false;
+    // Check the frame before decoding it, the decoder would happily turn a truncated frame into a partly grey image.
+    if (!checkFrame(frame))
+    {
+        return "";
+    }
+
+    // At a coarse scale of 8 the coarse image is the same size as the thumbnail, so it's decoded once and used for both.
+    if (coarse_scale == 8)
+    {
+        jpgd::jpeg_decoder_mem_stream stream;
+        stream.open_in_place(frame.getData(), frame.getSize());
+        zxing::ArrayRef<char> image;
+        int width, height;
+        if (!decodeImage(stream, coarse_scale, image, width, height))
+        {
+            // Like when frameChanged() can't decode the thumbnail, the frame counts as changed and has no code.
+            changed = true;
+            last_result.clear();
+            return last_result;
+        }
+        changed = imageChanged(image, width, height, coarse_scale);
+        if (changed)
+        {
+            last_result = searchCoarse(frame, image, width, height);
+        }
+        return last_result;
+    }
+
+    // When the camera sees the same scene as before, searching it again would give the same result.
+    changed = frameChanged(frame);
+    if (!changed)
+    {
+        return last_result;
+    }
+
+    last_result = searchFrame(frame);
+    return last_result;
+}
+
+std::string QRDetector::searchFrame(FrameBuffer& frame)
+{
+    // Most frames contain no code at all, and a large code is also found in a reduced size image, which is a lot cheaper to decode and search.
+    // Only when something looking like a code was seen, but could not be read, the full size image is tried.
+    if (coarse_scale > 1)
+    {
+        bool found_pattern = false;
+        std::string text = decodeFrame(frame, coarse_scale, found_pattern);
+        if (!text.empty() || !found_pattern)
+        {
+            return text;
+        }
+    }
 
-    // Decompress the jpeg from the obtained data.
-    char* buffer = reinterpret_cast<char*>(jpgd::decompress_jpeg_image_from_memory(reinterpret_cast<const unsigned char *>(camera_request.getData().c_str()), size, &width, &height, &comps, 4));
-    zxing::ArrayRef<char> image = zxing::ArrayRef<char>(buffer, 4 * width * height);
-    free(buffer);
+    bool found_pattern = false;
+    return decodeFrame(frame, 1, found_pattern);
+}
 
-    // Convert the obtained data to the right format.
-    zxing::Ref<zxing::LuminanceSource> source = zxing::Ref<zxing::LuminanceSource>(new ImageReaderSource(image, width, height, comps));
+std::string QRDetector::detectIncoming(jpgd::jpeg_decoder_stream& incoming)
+{
+    zxing::ArrayRef<char> image;
+    int width, height;
+    bool decoded = decodeImage(incoming, coarse_scale, image, width, height);
+
+    // Also when decoding failed, the frame has to be received completely before the next one can be requested.
+    if (!frame_source->finishGrab())
+    {
+        std::cout << "Unable to grab frame" << std::endl;
+        return "";
+    }
+
+    // The frame can only be checked now that it's complete. A truncated frame was decoded as far as it got, so nothing found in it counts.
+    FrameBuffer& frame = frame_source->getFrame();
+    if (!checkFrame(frame) || !decoded)
+    {
+        return "";
+    }
+
+    // The image is decoded already, so the thumbnail is made from it instead of from the frame.
+    if (!imageChanged(image, width, height, coarse_scale))
+    {
+        return last_result;
+    }
+
+    last_result = searchCoarse(frame, image, width, height);
+    return last_result;
+}
+
+bool QRDetector::decodeCoarse(FrameBuffer& frame, zxing::ArrayRef<char>& image, int& width, int& height, bool& changed)
+{
+    if (!checkFrame(frame))
+    {
+        return false;
+    }
+    jpgd::jpeg_decoder_mem_stream stream;
+    stream.open_in_place(frame.getData(), frame.getSize());
+    if (!decodeImage(stream, coarse_scale, image, width, height, false))
+    {
+        return false;
+    }
+    changed = imageChanged(image, width, height, coarse_scale);
+    return true;
+}
+
+std::string QRDetector::searchCoarse(FrameBuffer& frame, zxing::ArrayRef<char> image, int width, int height)
+{
+    bool found_pattern = false;
+    std::string text = searchImage(image, width, height, coarse_scale, found_pattern);
+
+    // Like in detect(), the full size image is only tried when the reduced one showed a code that could not be read.
+    if (coarse_scale > 1 && text.empty() && found_pattern)
+    {
+        found_pattern = false;
+        text = decodeFrame(frame, 1, found_pattern);
+    }
+    return text;
+}
+
+bool QRDetector::checkFrame(const FrameBuffer& frame)
+{
+    JpegInfo info;
+    if (!info.parse(frame.getData(), frame.getSize()))
+    {
+        std::cout << "Received frame is not a JPEG image (" << frame.getSize() << " bytes)" << std::endl;
+        return false;
+    }
+    if (!info.complete)
+    {
+        std::cout << "Received incomplete frame (" << frame.getSize() << " bytes)" << std::endl;
+        return false;
+    }
+    if (info.width != frame_width || info.height != frame_height)
+    {
+        std::cout << "Camera resolution is " << info.width << "x" << info.height << std::endl;
+        frame_width = info.width;
+        frame_height = info.height;
+        luminance_pool.trim();
+        change_detector.reset();
+    }
+    return true;
+}
+
+void QRDetector::setDecodeHints(zxing::DecodeHints hints)
+{
+    this->hints = hints;
+
+    bool only_qr_codes = hints.containsFormat(zxing::BarcodeFormat::QR_CODE);
+    for (int format = zxing::BarcodeFormat::AZTEC; format <= zxing::BarcodeFormat::UPC_EAN_EXTENSION; format++)
+    {
+        if (format != zxing::BarcodeFormat::QR_CODE && hints.containsFormat(zxing::BarcodeFormat(static_cast<zxing::BarcodeFormat::Value>(format))))
+        {
+            only_qr_codes = false;
+        }
+    }
+
+    // The readers are only created here, so they are re-used for every frame.
+    if (only_qr_codes)
+    {
+        reader = zxing::Ref<zxing::Reader>(new zxing::qrcode::QRCodeReader);
+        multi_format_reader = zxing::Ref<zxing::MultiFormatReader>();
+    } else
+    {
+        multi_format_reader = zxing::Ref<zxing::MultiFormatReader>(new zxing::MultiFormatReader);
+        multi_format_reader->setHints(hints);
+        reader = multi_format_reader;
+    }
+}
+
+bool QRDetector::setCoarseScale(int scale)
+{
+    if (!isCoarseScale(scale))
+    {
+        return false;
+    }
+    coarse_scale = scale;
+    return true;
+}
+
+bool QRDetector::isCoarseScale(int scale)
+{
+    // The scales jpgd can decode at.
+    return scale == 1 || scale == 2 || scale == 4 || scale == 8;
+}
+
+void QRDetector::setChangeThreshold(int threshold)
+{
+    change_detector.setThreshold(threshold);
+}
+
+void QRDetector::setDecodeThreads(int count)
+{
+    decode_executor.reset();
+    decode_threads.reset();
+    if (count != 1)
+    {
+        decode_threads.reset(new ThreadPool(count));
+        decode_executor.reset(new ThreadPoolExecutor(*decode_threads));
+    }
+    if (decoder)
+    {
+        decoder->set_executor(decode_executor.get());
+    }
+}
+
+void QRDetector::setRegionOfInterest(int x, int y, int width, int height)
+{
+    roi_x = x;
+    roi_y = y;
+    roi_width = width;
+    roi_height = height;
+    // The thumbnails of the old region can't be compared with those of the new one.
+    change_detector.reset();
+}
+
+std::string QRDetector::decodeFrame(FrameBuffer& frame, int scale, bool& found_pattern)
+{
+    // The decoder reads the frame in place from the frame buffer, which requires the real size of the data.
+    jpgd::jpeg_decoder_mem_stream stream;
+    stream.open_in_place(frame.getData(), frame.getSize());
+    zxing::ArrayRef<char> image;
+    int width, height;
+    if (!decodeImage(stream, scale, image, width, height))
+    {
+        return "";
+    }
+    return searchImage(image, width, height, scale, found_pattern);
+}
+
+bool QRDetector::frameChanged(FrameBuffer& frame)
+{
+    // At 1/8 size the IDCT of a block is only its DC coefficient, but the Huffman decoding still has to go through all coefficients of all blocks.
+    // So the thumbnail costs about as much as a coarse image at scale 8, and a good deal less than one at scale 2 or 4.
+    jpgd::jpeg_decoder_mem_stream stream;
+    stream.open_in_place(frame.getData(), frame.getSize());
+    if (!startDecoder(stream, 8))
+    {
+        // Let the normal decoding report the problem.
+        return true;
+    }
+    int width = decoder->get_width();
+    int height = decoder->get_height();
+    thumbnail.resize(width * height);
+    for (int y = 0; y < height; y++)
+    {
+        if (decoder->decode_luma(&thumbnail[y * width]) != jpgd::JPGD_SUCCESS)
+        {
+            return true;
+        }
+    }
+    return change_detector.update(thumbnail.data(), width, height);
+}
+
+bool QRDetector::imageChanged(zxing::ArrayRef<char> image, int width, int height, int scale)
+{
+    // Average the image down to the same 1/8 size as the thumbnail of frameChanged().
+    int block = 8 / scale;
+    if (block <= 1)
+    {
+        return change_detector.update(reinterpret_cast<const uint8_t*>(&image[0]), width, height);
+    }
+    LuminanceView view(image, width / block, height / block, 0, 1, width, block);
+    zxing::ArrayRef<char> matrix = view.getMatrix();
+    return change_detector.update(reinterpret_cast<const uint8_t*>(&matrix[0]), width / block, height / block);
+}
+
+bool QRDetector::startDecoder(jpgd::jpeg_decoder_stream& stream, int scale)
+{
+    unsigned int flags = 0;
+    switch(scale)
+    {
+        case 2: flags = jpgd::JPGD_FLAG_SCALE_1_2; break;
+        case 4: flags = jpgd::JPGD_FLAG_SCALE_1_4; break;
+        case 8: flags = jpgd::JPGD_FLAG_SCALE_1_8; break;
+    }
+
+    // Decompress the jpeg from the stream.
+    // Only the luminance is requested, so the decoder skips the chroma and the result can be used by zxing as is.
+    if (!decoder)
+    {
+        decoder.reset(new jpgd::jpeg_decoder(&stream, flags | jpgd::JPGD_FLAG_LUMA_ONLY));
+        decoder->set_executor(decode_executor.get());
+    }
+    else
+    {
+        decoder->reset(&stream, flags | jpgd::JPGD_FLAG_LUMA_ONLY);
+    }
+    if (decoder->get_error_code() != jpgd::JPGD_SUCCESS)
+    {
+        std::cout << "Unable to decode frame" << std::endl;
+        return false;
+    }
+    if (roi_width > 0 && roi_height > 0 && !decoder->set_crop_rect(roi_x, roi_y, roi_width, roi_height))
+    {
+        std::cout << "Region of interest is outside of the frame" << std::endl;
+        return false;
+    }
+    if (decoder->begin_decoding() != jpgd::JPGD_SUCCESS)
+    {
+        std::cout << "Unable to decode frame" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool QRDetector::decodeImage(jpgd::jpeg_decoder_stream& stream, int scale, zxing::ArrayRef<char>& image, int& width, int& height, bool pooled)
+{
+    if (!startDecoder(stream, scale))
+    {
+        return false;
+    }
+
+    // The decoded image is sized from the dimensions in the frame itself, so any camera resolution works.
+    width = decoder->get_width();
+    height = decoder->get_height();
+    // The scanlines go straight into a luminance matrix from the pool, zxing uses it without copying and gives it back by dropping its references.
+    if (pooled)
+    {
+        image = luminance_pool.get(width * height);
+    } else if (!image || image->size() != width * height)
+    {
+        image = zxing::ArrayRef<char>(width * height);
+    }
+    for (int y = 0; y < height; y++)
+    {
+        if (decoder->decode_luma(reinterpret_cast<jpgd::uint8*>(&image[y * width])) != jpgd::JPGD_SUCCESS)
+        {
+            std::cout << "Unable to decode frame" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string QRDetector::searchImage(zxing::ArrayRef<char> image, int width, int height, int scale, bool& found_pattern)
+{
+    zxing::Ref<zxing::Result> result;
+    zxing::Ref<zxing::LuminanceSource> source = zxing::Ref<zxing::LuminanceSource>(new ImageReaderSource(image, width, height, 1));
     zxing::Ref<zxing::Binarizer> binarizer;
     binarizer = new zxing::HybridBinarizer(source);
     zxing::Ref<zxing::BinaryBitmap> binary(new zxing::BinaryBitmap(binarizer));
     try
     {
-        result = reader->decode(binary, hints);
+        // MultiFormatReader::decode() sets up its readers for the hints every time, decodeWithState() uses the ones set up by setDecodeHints().
+        if (multi_format_reader)
+        {
+            result = multi_format_reader->decodeWithState(binary);
+        } else
+        {
+            result = reader->decode(binary, hints);
+        }
+    } catch (const zxing::NotFoundException& e)
+    {
+        if (scale == 1)
+        {
+            std::cout << "zxing::ReaderException: " + std::string(e.what()) << std::endl;
+        }
+        return "";
     } catch (const zxing::ReaderException& e)
     {
-        std::cout << "zxing::ReaderException: " + std::string(e.what()) << std::endl;
+        // A checksum or format error: there is a code in the image, it just could not be read.
+        found_pattern = true;
+        if (scale == 1)
+        {
+            std::cout << "zxing::ReaderException: " + std::string(e.what()) << std::endl;
+        }
         return "";
     }
 
     return result->getText()->getText();
 }
-
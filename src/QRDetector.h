@@ -1,22 +1,175 @@
 #ifndef QRDETECTOR_H
 #define QRDETECTOR_H
 
+#include <memory>
 #include <string>
+#include <vector>
+
+#include <zxing/DecodeHints.h>
+#include <zxing/MultiFormatReader.h>
+
+#include "FrameSource.h"
+#include "Image/ChangeDetector.h"
+#include "Image/LuminancePool.h"
+
+namespace jpgd
+{
+    class jpeg_decoder;
+    class jpeg_decoder_executor;
+    class jpeg_decoder_stream;
+}
+class ThreadPool;
+
 class QRDetector
 {
 public:
     /** Simple QR detector that grabs an image from provided URL.
-     * /param url URL from which to grab an image.
+     * /param url URL from which to grab an image. This can be a snapshot URL, or a mjpg-streamer "?action=stream" URL.
      */
     QRDetector(std::string url);
 
+    /** Detector without a frame source, that only searches the frames passed to detectFrame().
+     */
+    QRDetector();
+    ~QRDetector();
+
     /** Detect grabs the frame from the URL and returns the data in the detected QR code (if any)
      * /returns string containing the detected data. The string is empty if no QR code is detected.
      */
     std::string detect();
 
+    /** Search a frame that was received elsewhere for a code, like detect().
+     *  This way the receiving and the decoding of frames can be done on different threads.
+     * /param frame Complete JPEG frame. It's decoded in place, so it's not const.
+     */
+    std::string detectFrame(FrameBuffer& frame);
+
+    /** Like detectFrame(), and tell whether the scene changed.
+     * /param changed Set to false when the camera sees the same scene as in the last changed frame, see setChangeThreshold().
+     */
+    std::string detectFrame(FrameBuffer& frame, bool& changed);
+
+    /** Decode a frame at the coarse scale, to search it with searchCoarse() later. Together they do what detectFrame() does,
+     *  but they can run on different threads for different frames, each with its own QRDetector with the same settings.
+     * /param image Receives the luminance of the frame. It's re-used when it has the right size, and it is not taken from the pool,
+     *              so it can be handed to the other thread.
+     * /param changed Set to false when the camera sees the same scene as in the last changed frame, see setChangeThreshold().
+     * /returns false if the frame can't be decoded, which is reported.
+     */
+    bool decodeCoarse(FrameBuffer& frame, zxing::ArrayRef<char>& image, int& width, int& height, bool& changed);
+
+    /** Search an image decoded by decodeCoarse() for a code.
+     *  When the image shows a code that could not be read, the full size image is decoded from the frame and searched.
+     * /returns the data in the code, or an empty string.
+     */
+    std::string searchCoarse(FrameBuffer& frame, zxing::ArrayRef<char> image, int width, int height);
+
+    /** Search for a code in a reduced size image first, which is a lot cheaper than the full image.
+     *  The full size image is only decoded when the reduced image shows a code that could not be read, not whenever nothing was found in it:
+     *  most frames contain no code at all, and decoding all of those at full size as well would cost more than not searching the reduced image.
+     *  So this misses codes that are too small to be seen at the reduced size, only use it when the code covers a large part of the image.
+     * /param scale 2, 4 or 8 to search a 1/2, 1/4 or 1/8 size image first. 1 (the default) always uses the full image.
+     * /returns false if the scale is not one of those, the scale is not changed then.
+     */
+    bool setCoarseScale(int scale);
+
+    /** /returns true if the scale can be passed to setCoarseScale().
+     */
+    static bool isCoarseScale(int scale);
+
+    /** Skip searching frames in which the camera sees the same scene as in the last searched frame, and return the result of that frame again.
+     *  Frames are compared by a 1/8 size thumbnail. It saves the IDCT of all but the DC coefficients, but every coefficient is still Huffman decoded,
+     *  so it costs about as much as a coarse scale of 8. With that coarse scale the thumbnail is made from the coarse image, so frames are only decoded once.
+     * /param threshold Difference in grey levels of a thumbnail pixel for the scene to count as changed, 10 by default. 0 searches every frame.
+     */
+    void setChangeThreshold(int threshold);
+
+    /** Only search for the barcode formats in the hints, for example zxing::DecodeHints::QR_CODE_HINT (the default) or zxing::DecodeHints::DEFAULT_HINT for all formats.
+     *  With only QR codes the QRCodeReader is used directly, instead of the MultiFormatReader trying each format in turn.
+     */
+    void setDecodeHints(zxing::DecodeHints hints);
+
+    /** Only search the given part of the frame for a code. Only the part of the JPEG image overlapping it is decoded.
+     *  The coordinates are in pixels of the full size frame. A width or height of 0 (the default) searches the whole frame.
+     */
+    void setRegionOfInterest(int x, int y, int width, int height);
+
+    /** Decode frames that are split into restart intervals on multiple threads. Other frames are always decoded on the calling thread.
+     * /param count Number of threads to use, 0 for one per CPU core. 1 (the default) decodes all frames on the calling thread.
+     */
+    void setDecodeThreads(int count);
+
 protected:
-    std::string url;
+    /** Detect a code in a frame that is decoded while it is being received.
+     * /param incoming Stream returned by FrameSource::startGrab().
+     */
+    std::string detectIncoming(jpgd::jpeg_decoder_stream& incoming);
+
+    /** Check that the frame is a complete JPEG image, and report when the resolution of the camera changed.
+     */
+    bool checkFrame(const FrameBuffer& frame);
+
+    /** Search a complete frame for a code, first at the coarse scale.
+     */
+    std::string searchFrame(FrameBuffer& frame);
+
+    /** Decode the frame at the given scale and search it for a code.
+     * /param found_pattern Set to true when a code was found in the image, but could not be read.
+     * /returns the data in the code, or an empty string.
+     */
+    std::string decodeFrame(FrameBuffer& frame, int scale, bool& found_pattern);
+
+    /** Decode a 1/8 size thumbnail of the frame and compare it with the last changed one.
+     * /returns true if the scene changed, or the thumbnail could not be decoded.
+     */
+    bool frameChanged(FrameBuffer& frame);
+
+    /** Like frameChanged(), but with the thumbnail made from an image already decoded at the given scale.
+     */
+    bool imageChanged(zxing::ArrayRef<char> image, int width, int height, int scale);
+
+    /** Set up the decoder for a JPEG image from the stream, at the given scale and cropped to the region of interest.
+     * /returns false if the image can't be decoded, which is reported.
+     */
+    bool startDecoder(jpgd::jpeg_decoder_stream& stream, int scale);
+
+    /** Decode a JPEG image from the stream at the given scale into a luminance matrix.
+     * /param pooled Take the matrix from the pool, otherwise the given image is re-used when it has the right size.
+     * /returns false if the image can't be decoded, which is reported.
+     */
+    bool decodeImage(jpgd::jpeg_decoder_stream& stream, int scale, zxing::ArrayRef<char>& image, int& width, int& height, bool pooled = true);
+
+    /** Search a luminance image for a code.
+     * /param scale Scale the image was decoded at, failures are only reported for the full size image.
+     * /param found_pattern Set to true when a code was found in the image, but could not be read.
+     * /returns the data in the code, or an empty string.
+     */
+    std::string searchImage(zxing::ArrayRef<char> image, int width, int height, int scale, bool& found_pattern);
+
+    std::unique_ptr<FrameSource> frame_source;
+    // Kept between frames, so decoding a frame re-uses the memory and tables of the previous one.
+    std::unique_ptr<jpgd::jpeg_decoder> decoder;
+    std::unique_ptr<ThreadPool> decode_threads;
+    std::unique_ptr<jpgd::jpeg_decoder_executor> decode_executor;
+    zxing::DecodeHints hints;
+    zxing::Ref<zxing::Reader> reader;
+    // Only set when more than QR codes are searched for, it's the same object as the reader then.
+    zxing::Ref<zxing::MultiFormatReader> multi_format_reader;
+    // Luminance matrices of the full size and the reduced size images, re-used for every frame.
+    LuminancePool luminance_pool;
+    ChangeDetector change_detector;
+    // Thumbnail of the current frame for the change_detector, re-used for every frame.
+    std::vector<uint8_t> thumbnail;
+    // Result of the last searched frame, returned again for frames in which nothing changed.
+    std::string last_result;
+    // Resolution of the last decoded frame, used to report when the camera resolution changes.
+    int frame_width;
+    int frame_height;
+    int coarse_scale;
+    int roi_x;
+    int roi_y;
+    int roi_width;
+    int roi_height;
 };
 
 #endif //IMAGE_READER_SOURCE_H
\ No newline at end of file
@@ -0,0 +1,338 @@
+#include "ScanEngine.h"
+
+#include "FrameSource.h"
+#include "QRDetector.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+CameraConfig::CameraConfig()
+: interval(500), coarse_scale(1), roi_x(0), roi_y(0), roi_width(0), roi_height(0)
+{
+}
+
+// Parse a whole field as a number that is not negative, "12x" or "-1" are not accepted.
+static bool parseNumber(const std::string& text, long& value)
+{
+    if (text.empty() || !isdigit(static_cast<unsigned char>(text[0])))
+    {
+        return false;
+    }
+    char* end;
+    errno = 0;
+    value = strtol(text.c_str(), &end, 10);
+    return *end == '\0' && errno == 0 && value <= INT_MAX;
+}
+
+// Parse an optional key=value field of a camera line.
+// /returns an error message, or an empty string when the field is valid.
+static std::string parseField(const std::string& field, CameraConfig& config)
+{
+    size_t separator = field.find('=');
+    if (separator == std::string::npos)
+    {
+        return "expected key=value instead of \"" + field + "\"";
+    }
+    std::string key = field.substr(0, separator);
+    std::string value = field.substr(separator + 1);
+    long number;
+    if (key == "interval")
+    {
+        if (!parseNumber(value, number))
+        {
+            return "interval must be a number of milliseconds";
+        }
+        config.interval = number;
+    } else if (key == "scale")
+    {
+        if (!parseNumber(value, number) || !QRDetector::isCoarseScale(number))
+        {
+            return "scale must be 1, 2, 4 or 8";
+        }
+        config.coarse_scale = number;
+    } else if (key == "roi")
+    {
+        // x,y,width,height
+        long numbers[4];
+        std::istringstream parts(value);
+        std::string part;
+        int count = 0;
+        while(std::getline(parts, part, ','))
+        {
+            if (count == 4 || !parseNumber(part, numbers[count]))
+            {
+                count = -1;
+                break;
+            }
+            count++;
+        }
+        if (count != 4 || (numbers[2] == 0) != (numbers[3] == 0))
+        {
+            return "roi must be x,y,width,height, with a width and height of both 0 or both more than 0";
+        }
+        config.roi_x = numbers[0];
+        config.roi_y = numbers[1];
+        config.roi_width = numbers[2];
+        config.roi_height = numbers[3];
+    } else
+    {
+        return "unknown setting \"" + key + "\"";
+    }
+    return "";
+}
+
+bool CameraConfig::load(const std::string& filename, std::vector<CameraConfig>& cameras)
+{
+    std::ifstream file(filename);
+    if (!file)
+    {
+        std::cout << "Unable to read " << filename << std::endl;
+        return false;
+    }
+    std::string line;
+    int line_number = 0;
+    while(std::getline(file, line))
+    {
+        line_number++;
+        std::istringstream fields(line);
+        CameraConfig config;
+        if (!(fields >> config.name) || config.name[0] == '#')
+        {
+            continue;
+        }
+        if (!(fields >> config.url))
+        {
+            std::cout << filename << ":" << line_number << ": camera " << config.name << " has no URL" << std::endl;
+            return false;
+        }
+        for (const CameraConfig& camera : cameras)
+        {
+            if (camera.name == config.name)
+            {
+                std::cout << filename << ":" << line_number << ": camera " << config.name << " is already defined" << std::endl;
+                return false;
+            }
+        }
+        // Streams deliver frames at the rate of the camera, so they are not paced unless an interval is set.
+        config.interval = FrameSource::isStreamUrl(config.url) ? 0 : 500;
+        std::string field;
+        while(fields >> field)
+        {
+            std::string error = parseField(field, config);
+            if (!error.empty())
+            {
+                std::cout << filename << ":" << line_number << ": camera " << config.name << ": " << error << std::endl;
+                return false;
+            }
+        }
+        cameras.push_back(config);
+    }
+    return true;
+}
+
+struct ScanEngine::Camera
+{
+    Camera(int id, const CameraConfig& config)
+    : id(id), config(config), queued(false), has_frame(false), frames(0), dropped_frames(0), failed_grabs(0), consecutive_failed_grabs(0)
+    {
+        detector.setCoarseScale(config.coarse_scale);
+        detector.setRegionOfInterest(config.roi_x, config.roi_y, config.roi_width, config.roi_height);
+    }
+
+    const int id;
+    const CameraConfig config;
+    // Only used by the worker that searches the frame of the camera, there's never more than one.
+    QRDetector detector;
+    FrameBuffer frame;
+
+    // The fields below are guarded by the mutex of the engine.
+    // Set while the camera is in the queue or a worker searches its frame.
+    bool queued;
+    // Newest received frame that was not searched yet, swapped with the one from the fetcher so it's never copied.
+    FrameBuffer received_frame;
+    bool has_frame;
+    std::string last_result;
+    int frames;
+    int dropped_frames;
+    int failed_grabs;
+    int consecutive_failed_grabs;
+};
+
+ScanEngine::ScanEngine(EventLoop& loop, int worker_count)
+: worker_count(worker_count)
+, fetcher(loop, [this](int id, FrameBuffer& frame) { onFrame(id, frame); }, [this](int id, const char* error) { onError(id, error); })
+, rate_controller([this](int id, uint64_t interval) { fetcher.setInterval(id, interval); })
+, stopping(false)
+{
+    if (this->worker_count <= 0)
+    {
+        this->worker_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+ScanEngine::~ScanEngine()
+{
+    stop();
+}
+
+void ScanEngine::addCamera(const CameraConfig& config)
+{
+    // The fetcher and the rate controller number their cameras in the same order, so their ids are the indices in the cameras.
+    int id = rate_controller.addCamera(config.interval);
+    fetcher.addCamera(config.url, rate_controller.getInterval(id));
+    cameras.push_back(std::unique_ptr<Camera>(new Camera(id, config)));
+}
+
+void ScanEngine::setResultCallback(ResultCallback callback)
+{
+    result_callback = callback;
+}
+
+void ScanEngine::start()
+{
+    stopping = false;
+    for (int i = 0; i < worker_count; i++)
+    {
+        workers.push_back(std::thread(&ScanEngine::workerMain, this));
+    }
+    fetcher.start();
+}
+
+void ScanEngine::stop()
+{
+    fetcher.stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+    workers.clear();
+
+    // Frames that were received but not searched are forgotten.
+    queue.clear();
+    for (std::unique_ptr<Camera>& camera : cameras)
+    {
+        camera->queued = false;
+        camera->has_frame = false;
+    }
+}
+
+ScanRateController& ScanEngine::getRateController()
+{
+    return rate_controller;
+}
+
+std::vector<ScanEngine::CameraStatus> ScanEngine::getStatus()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<CameraStatus> status;
+    for (std::unique_ptr<Camera>& camera : cameras)
+    {
+        status.push_back(CameraStatus{camera->config.name, camera->last_result, camera->frames, camera->dropped_frames, camera->failed_grabs, camera->consecutive_failed_grabs});
+    }
+    return status;
+}
+
+void ScanEngine::onFrame(int id, FrameBuffer& frame)
+{
+    Camera& camera = *cameras[id];
+    bool queue_camera = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Only the newest frame matters, a frame that was not searched yet is dropped. Its buffer goes back to the fetcher to receive the next one.
+        if (camera.has_frame)
+        {
+            camera.dropped_frames++;
+        }
+        camera.received_frame.swap(frame);
+        camera.has_frame = true;
+        camera.consecutive_failed_grabs = 0;
+        if (!camera.queued)
+        {
+            camera.queued = true;
+            queue.push_back(&camera);
+            queue_camera = true;
+        }
+    }
+    if (queue_camera)
+    {
+        work_available.notify_one();
+    }
+    // A camera in which nothing happened for a while is slowed down. Only done after the frame was swapped out, the fetcher may re-use its buffer.
+    rate_controller.update(id);
+}
+
+void ScanEngine::onError(int id, const char* error)
+{
+    Camera& camera = *cameras[id];
+    std::lock_guard<std::mutex> lock(mutex);
+    camera.failed_grabs++;
+    camera.consecutive_failed_grabs++;
+    // Only report when a camera starts failing, not on every retry.
+    if (camera.consecutive_failed_grabs == 1)
+    {
+        std::cout << "Unable to grab frame from " << camera.config.name << ": " << error << std::endl;
+    }
+}
+
+void ScanEngine::workerMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        work_available.wait(lock, [this]() { return stopping || !queue.empty(); });
+        if (stopping)
+        {
+            return;
+        }
+        Camera& camera = *queue.front();
+        queue.pop_front();
+        camera.frame.swap(camera.received_frame);
+        camera.has_frame = false;
+
+        lock.unlock();
+        bool scene_changed;
+        std::string text = camera.detector.detectFrame(camera.frame, scene_changed);
+        lock.lock();
+
+        camera.frames++;
+        bool changed = text != camera.last_result;
+        if (scene_changed || changed)
+        {
+            rate_controller.reportActivity(camera.id);
+        }
+        camera.last_result = text;
+
+        if (changed && result_callback)
+        {
+            // Report outside of the engine mutex, so a slow callback only holds up the workers that report as well.
+            // The camera is only queued again afterwards, so the next frame of this camera can't be reported before this one.
+            lock.unlock();
+            {
+                std::lock_guard<std::mutex> callback_lock(callback_mutex);
+                result_callback(camera.config.name, text);
+            }
+            lock.lock();
+        }
+
+        // A frame that arrived meanwhile waits at the back of the queue, so the other cameras get their turn first.
+        if (camera.has_frame)
+        {
+            queue.push_back(&camera);
+            work_available.notify_one();
+        } else
+        {
+            camera.queued = false;
+        }
+    }
+}
@@ -0,0 +1,131 @@
+#ifndef SCAN_ENGINE_H
+#define SCAN_ENGINE_H
+
+#include <stdint.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameFetcher.h"
+#include "ScanRateController.h"
+#include "System/NoCopy.h"
+
+/** Settings of a single camera scanned by the ScanEngine.
+ */
+struct CameraConfig
+{
+    CameraConfig();
+
+    // Name used to report the results of the camera.
+    std::string name;
+    std::string url;
+    // Milliseconds between the start of two grabs when a code is expected, see ScanRateController. Streams deliver frames at the rate of the camera then, so they are not paced by default.
+    uint64_t interval;
+    // See QRDetector::setCoarseScale().
+    int coarse_scale;
+    // See QRDetector::setRegionOfInterest(), a width or height of 0 searches the whole frame.
+    int roi_x;
+    int roi_y;
+    int roi_width;
+    int roi_height;
+
+    /** Read the cameras from a configuration file.
+     *  Every line holds a camera as: name url [interval=milliseconds] [scale=coarse_scale] [roi=x,y,width,height]
+     *  The optional settings can be given in any order. Without an interval snapshots are grabbed every 500 ms, and streams are not paced.
+     *  Empty lines and lines starting with # are skipped.
+     * /param filename File to read.
+     * /param cameras The cameras are added to this.
+     * /returns false if the file can't be read or has an invalid line, which is reported with its line number.
+     */
+    static bool load(const std::string& filename, std::vector<CameraConfig>& cameras);
+};
+
+/** The ScanEngine searches the frames of many cameras for codes at the same time.
+ *  All frames are received by a FrameFetcher, on the thread that runs the EventLoop.
+ *  The received frames are queued for a fixed pool of worker threads, one per CPU core, that decode and search them in the order they arrived.
+ *  Each camera has its own QRDetector, so its settings, last result and buffers are never shared.
+ *  A camera only has one frame queued at a time: a newer frame replaces it, so a camera that is searched slower than it delivers frames only delays itself.
+ *  A ScanRateController slows down the cameras that see nothing new, and the workers report the frames in which the scene or the code changed to it.
+ */
+class ScanEngine : public NoCopy
+{
+public:
+    /** Called from a worker thread with the name of the camera and the data in the code, whenever the result of a camera changes.
+     *  The text is empty when the code disappeared. Calls are never made at the same time.
+     */
+    typedef std::function<void(const std::string& name, const std::string& text)> ResultCallback;
+
+    /** Counters of a single camera, see getStatus().
+     */
+    struct CameraStatus
+    {
+        std::string name;
+        std::string last_result;
+        // Frames that were searched.
+        int frames;
+        // Frames that were replaced by a newer one before they were searched.
+        int dropped_frames;
+        // Transfers that failed, in total and since the last frame that was received.
+        int failed_grabs;
+        int consecutive_failed_grabs;
+    };
+
+    /** Create an engine without cameras.
+     * /param loop EventLoop that receives the frames. The engine should only be started and stopped on its thread, or while it is not running.
+     * /param worker_count Number of threads that decode and search frames, 0 for one per CPU core.
+     */
+    ScanEngine(EventLoop& loop, int worker_count = 0);
+    ~ScanEngine();
+
+    /** Add a camera. Cameras can only be added before start().
+     */
+    void addCamera(const CameraConfig& config);
+
+    void setResultCallback(ResultCallback callback);
+
+    /** Start grabbing and searching the frames of all cameras.
+     */
+    void start();
+
+    /** Stop all threads, and abort the transfers in progress.
+     */
+    void stop();
+
+    /** The controller of the intervals of the cameras, to set the idle interval and the procedures to watch.
+     *  Only use it on the thread of the EventLoop.
+     */
+    ScanRateController& getRateController();
+
+    /** Get a copy of the counters of all cameras, in the order they were added.
+     */
+    std::vector<CameraStatus> getStatus();
+
+private:
+    struct Camera;
+
+    // Called by the FrameFetcher on the thread of the EventLoop.
+    void onFrame(int id, FrameBuffer& frame);
+    void onError(int id, const char* error);
+    void workerMain();
+
+    int worker_count;
+    FrameFetcher fetcher;
+    ScanRateController rate_controller;
+    std::vector<std::unique_ptr<Camera>> cameras;
+    std::vector<std::thread> workers;
+    ResultCallback result_callback;
+    std::mutex callback_mutex;
+
+    std::mutex mutex;
+    // Cameras with a received frame, in the order the frames arrived.
+    std::deque<Camera*> queue;
+    std::condition_variable work_available;
+    bool stopping;
+};
+
+#endif //SCAN_ENGINE_H
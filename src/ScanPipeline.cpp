@@ -0,0 +1,194 @@
+#include "ScanPipeline.h"
+
+#include <iostream>
+
+// Number of frames that can wait for the decode stage, and for the search stage.
+static const int QUEUE_SIZE = 2;
+// Enough items to fill both queues, plus one in each stage.
+static const int ITEM_COUNT = 2 * QUEUE_SIZE + 3;
+
+ScanPipeline::ScanPipeline(EventLoop& loop, std::string url, result_callback_t callback)
+: fetcher(loop, [this](int id, FrameBuffer& frame) { onFrame(frame); }, [this](int id, const char* error) { onError(error); })
+, rate_controller([this](int id, uint64_t interval) { fetcher.setInterval(id, interval); })
+, url(url), callback(callback), interval(500), camera_added(false)
+, items(new Item[ITEM_COUNT]), fetched_queue(QUEUE_SIZE), decoded_queue(QUEUE_SIZE)
+, decode_recycle_queue(ITEM_COUNT), search_recycle_queue(ITEM_COUNT)
+, running(false), dropped_frames(0)
+{
+    for (int i = 0; i < ITEM_COUNT; i++)
+    {
+        free_items.push_back(&items[i]);
+    }
+}
+
+ScanPipeline::~ScanPipeline()
+{
+    stop();
+}
+
+bool ScanPipeline::setCoarseScale(int scale)
+{
+    return decode_detector.setCoarseScale(scale) && search_detector.setCoarseScale(scale);
+}
+
+void ScanPipeline::setRegionOfInterest(int x, int y, int width, int height)
+{
+    decode_detector.setRegionOfInterest(x, y, width, height);
+    search_detector.setRegionOfInterest(x, y, width, height);
+}
+
+void ScanPipeline::setDecodeThreads(int count)
+{
+    decode_detector.setDecodeThreads(count);
+}
+
+void ScanPipeline::setInterval(uint64_t interval)
+{
+    this->interval = interval;
+}
+
+void ScanPipeline::start()
+{
+    if (!camera_added)
+    {
+        fetcher.addCamera(url, rate_controller.getInterval(rate_controller.addCamera(interval)));
+        camera_added = true;
+    }
+    running = true;
+    decode_thread = std::thread(&ScanPipeline::decodeMain, this);
+    search_thread = std::thread(&ScanPipeline::searchMain, this);
+    fetcher.start();
+}
+
+void ScanPipeline::stop()
+{
+    if (!decode_thread.joinable())
+    {
+        return;
+    }
+    fetcher.stop();
+    running = false;
+    decode_wakeup.notify();
+    search_wakeup.notify();
+    decode_thread.join();
+    search_thread.join();
+
+    // Collect the items that were left in the queues, so the pipeline can be started again.
+    Item* item;
+    while(fetched_queue.pop(item) || decoded_queue.pop(item) || decode_recycle_queue.pop(item) || search_recycle_queue.pop(item))
+    {
+        free_items.push_back(item);
+    }
+}
+
+ScanRateController& ScanPipeline::getRateController()
+{
+    return rate_controller;
+}
+
+int ScanPipeline::getDroppedFrames() const
+{
+    return dropped_frames;
+}
+
+void ScanPipeline::onFrame(FrameBuffer& frame)
+{
+    Item* item;
+    while(decode_recycle_queue.pop(item) || search_recycle_queue.pop(item))
+    {
+        free_items.push_back(item);
+    }
+    // The queues and the other stages hold one item less than there are, so this only happens when something is off.
+    if (free_items.empty())
+    {
+        dropped_frames++;
+        rate_controller.update(0);
+        return;
+    }
+    item = free_items.back();
+    free_items.pop_back();
+    // Swap instead of copy, the fetcher receives the next frame in the old buffer of the item.
+    item->frame.swap(frame);
+
+    Item* dropped;
+    if (fetched_queue.push(item, dropped))
+    {
+        dropped_frames++;
+        free_items.push_back(dropped);
+    }
+    decode_wakeup.notify();
+    // When nothing happened for a while the camera is slowed down, from the next frame on.
+    // Only done after the frame was swapped out, the fetcher may re-use its buffer.
+    rate_controller.update(0);
+}
+
+void ScanPipeline::onError(const char* error)
+{
+    std::cout << "Unable to grab frame: " << error << std::endl;
+}
+
+void ScanPipeline::decodeMain()
+{
+    // Set when a changed frame was dropped before it was searched, so the next frame is searched even when it shows the same scene.
+    bool lost_change = false;
+    while(running)
+    {
+        Item* item;
+        if (!fetched_queue.pop(item))
+        {
+            decode_wakeup.wait();
+            continue;
+        }
+
+        // The recycle queue holds all items, so it never drops one.
+        Item* unused;
+        if (!decode_detector.decodeCoarse(item->frame, item->image, item->width, item->height, item->changed))
+        {
+            decode_recycle_queue.push(item, unused);
+            continue;
+        }
+        if (item->changed)
+        {
+            rate_controller.reportActivity(0);
+        }
+        item->changed = item->changed || lost_change;
+        lost_change = false;
+
+        Item* dropped;
+        if (decoded_queue.push(item, dropped))
+        {
+            dropped_frames++;
+            lost_change = dropped->changed;
+            decode_recycle_queue.push(dropped, unused);
+        }
+        search_wakeup.notify();
+    }
+}
+
+void ScanPipeline::searchMain()
+{
+    std::string last_result;
+    while(running)
+    {
+        Item* item;
+        if (!decoded_queue.pop(item))
+        {
+            search_wakeup.wait();
+            continue;
+        }
+
+        if (item->changed)
+        {
+            std::string text = search_detector.searchCoarse(item->frame, item->image, item->width, item->height);
+            if (text != last_result)
+            {
+                rate_controller.reportActivity(0);
+            }
+            last_result = text;
+        }
+        // The item is only handed back after the search, when zxing dropped all its references to the image.
+        Item* unused;
+        search_recycle_queue.push(item, unused);
+        callback(last_result);
+    }
+}
@@ -0,0 +1,124 @@
+#ifndef SCAN_PIPELINE_H
+#define SCAN_PIPELINE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <zxing/common/Array.h>
+
+#include "FrameBuffer.h"
+#include "FrameFetcher.h"
+#include "QRDetector.h"
+#include "ScanRateController.h"
+#include "System/EventLoop.h"
+#include "System/NoCopy.h"
+#include "System/SpscQueue.h"
+#include "System/Wakeup.h"
+
+/** Scans a single camera in three stages: fetching a frame, decoding the JPEG, and searching it with zxing.
+ *  The frames are fetched by a FrameFetcher on the thread of an EventLoop, and the other stages have a thread of their own.
+ *  While frame N is searched, frame N+1 is decoded and frame N+2 is fetched, so the frame rate is limited by the slowest stage instead of the sum of all three.
+ *  The stages hand their frames on through lock-free SpscQueues. When a stage falls behind, the oldest frame waiting for it is dropped, so the results stay fresh.
+ *  A stage without frames sleeps on a Wakeup until the previous stage pushes one.
+ *  The frames travel through the stages in a fixed set of items, which are handed back to the fetch stage when they are done or dropped,
+ *  so the frame buffers and luminance matrices are re-used and nothing is allocated for a frame.
+ *  A ScanRateController slows the camera down while it sees nothing new.
+ */
+class ScanPipeline : public NoCopy
+{
+public:
+    /** Called on the search thread with the data in the code of every searched frame, or an empty string if it has none.
+     */
+    typedef std::function<void(const std::string& text)> result_callback_t;
+
+    /** Create a pipeline for the given URL. Nothing is fetched until start() is called.
+     * /param loop EventLoop that fetches the frames. The pipeline should only be started and stopped on its thread, or while it is not running.
+     * /param url Snapshot or mjpg-streamer "?action=stream" URL of the camera.
+     */
+    ScanPipeline(EventLoop& loop, std::string url, result_callback_t callback);
+    ~ScanPipeline();
+
+    /** See QRDetector::setCoarseScale(). Only call this before start().
+     * /returns false if the scale is not 1, 2, 4 or 8.
+     */
+    bool setCoarseScale(int scale);
+
+    /** See QRDetector::setRegionOfInterest(). Only call this before start().
+     */
+    void setRegionOfInterest(int x, int y, int width, int height);
+
+    /** See QRDetector::setDecodeThreads(), used for the decode stage. Only call this before start().
+     */
+    void setDecodeThreads(int count);
+
+    /** Set the milliseconds between the start of two snapshot requests when a code is expected, 500 by default. Only call this before the first start().
+     */
+    void setInterval(uint64_t interval);
+
+    void start();
+    void stop();
+
+    /** The controller of the interval of the camera, to set the idle interval and the procedures to watch. The camera has id 0.
+     *  Only use it on the thread of the EventLoop.
+     */
+    ScanRateController& getRateController();
+
+    /** Number of frames that were dropped because the decoding or searching fell behind.
+     */
+    int getDroppedFrames() const;
+
+private:
+    // A frame on its way through the stages.
+    struct Item
+    {
+        Item() : width(0), height(0), changed(false) {}
+
+        FrameBuffer frame;
+        // Luminance of the frame at the coarse scale, filled by the decode stage.
+        zxing::ArrayRef<char> image;
+        int width;
+        int height;
+        // Set by the decode stage when the scene changed, unchanged frames are not searched.
+        bool changed;
+    };
+
+    // Called by the FrameFetcher on the thread of the EventLoop.
+    void onFrame(FrameBuffer& frame);
+    void onError(const char* error);
+    void decodeMain();
+    void searchMain();
+
+    FrameFetcher fetcher;
+    ScanRateController rate_controller;
+    std::string url;
+    result_callback_t callback;
+    uint64_t interval;
+    // The camera is only added to the fetcher and the rate controller on the first start(), after the interval is set.
+    bool camera_added;
+    // Each stage that decodes has its own detector, so they never share a decoder or the reference counts of zxing.
+    QRDetector decode_detector;
+    QRDetector search_detector;
+
+    std::unique_ptr<Item[]> items;
+    // Items that the fetch stage can fill, only used by the thread of the EventLoop.
+    std::vector<Item*> free_items;
+    SpscQueue<Item*> fetched_queue;
+    SpscQueue<Item*> decoded_queue;
+    // Items handed back to the fetch stage by the other stages.
+    SpscQueue<Item*> decode_recycle_queue;
+    SpscQueue<Item*> search_recycle_queue;
+    Wakeup decode_wakeup;
+    Wakeup search_wakeup;
+
+    std::atomic<bool> running;
+    std::atomic<int> dropped_frames;
+    std::thread decode_thread;
+    std::thread search_thread;
+};
+
+#endif //SCAN_PIPELINE_H
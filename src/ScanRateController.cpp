@@ -0,0 +1,109 @@
+#include "ScanRateController.h"
+
+#include "DBus/DBusPrinter.h"
+#include "System/Clock.h"
+
+#include <algorithm>
+
+ScanRateController::ScanRateController(interval_callback_t callback)
+: callback(callback), idle_interval(5000), hold_time(10000)
+{
+}
+
+int ScanRateController::addCamera(uint64_t fast_interval)
+{
+    Camera* camera = new Camera(fast_interval);
+    camera->interval = pickInterval(*camera);
+    cameras.push_back(std::unique_ptr<Camera>(camera));
+    return cameras.size() - 1;
+}
+
+void ScanRateController::setIdleInterval(uint64_t interval)
+{
+    idle_interval = interval;
+    updateAll();
+}
+
+void ScanRateController::setHoldTime(uint64_t time)
+{
+    hold_time = time;
+}
+
+void ScanRateController::watchProcedure(const std::string& key, const std::vector<std::string>& steps)
+{
+    // Only attach the callbacks once, watching a procedure again only adds steps.
+    bool attach = watched_procedures.find(key) == watched_procedures.end();
+    watched_procedures[key].insert(steps.begin(), steps.end());
+    if (!attach)
+    {
+        return;
+    }
+    DBusPrinter* printer = DBusPrinter::getInstance();
+    printer->attachStartProcedure(key, [this, key](std::string step) { setProcedureStep(key, step); });
+    printer->attachNextStepProcedure(key, [this, key](std::string step) { setProcedureStep(key, step); });
+    printer->attachFinishedProcedure(key, [this, key]() { setProcedureFinished(key); });
+}
+
+void ScanRateController::reportActivity(int id)
+{
+    cameras[id]->last_activity = getMilliseconds();
+}
+
+void ScanRateController::update(int id)
+{
+    Camera& camera = *cameras[id];
+    uint64_t interval = pickInterval(camera);
+    if (interval != camera.interval)
+    {
+        camera.interval = interval;
+        callback(id, interval);
+    }
+}
+
+uint64_t ScanRateController::getInterval(int id) const
+{
+    return cameras[id]->interval;
+}
+
+void ScanRateController::setProcedureStep(const std::string& key, const std::string& step)
+{
+    const std::set<std::string>& steps = watched_procedures[key];
+    if (steps.empty() || steps.find(step) != steps.end())
+    {
+        waiting_procedures.insert(key);
+    } else
+    {
+        waiting_procedures.erase(key);
+    }
+    updateAll();
+}
+
+void ScanRateController::setProcedureFinished(const std::string& key)
+{
+    waiting_procedures.erase(key);
+    updateAll();
+}
+
+void ScanRateController::updateAll()
+{
+    for (unsigned int id = 0; id < cameras.size(); id++)
+    {
+        update(id);
+    }
+}
+
+uint64_t ScanRateController::pickInterval(const Camera& camera) const
+{
+    if (!waiting_procedures.empty())
+    {
+        return camera.fast_interval;
+    }
+    // Read the time of the activity before the clock, a search thread may report activity meanwhile.
+    uint64_t last_activity = camera.last_activity;
+    if (last_activity > 0 && last_activity + hold_time > getMilliseconds())
+    {
+        return camera.fast_interval;
+    }
+    // A camera that is configured slower than the idle interval is never sped up.
+    return std::max(idle_interval, camera.fast_interval);
+}
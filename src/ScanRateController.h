@@ -0,0 +1,91 @@
+#ifndef SCAN_RATE_CONTROLLER_H
+#define SCAN_RATE_CONTROLLER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "System/NoCopy.h"
+
+/** The ScanRateController picks the interval between the frames of each camera, so a camera is only scanned fast when a code is expected.
+ *  A camera is scanned at its own fast interval while a watched printer procedure waits for a code, and for a while after the camera saw motion or a code changed.
+ *  The rest of the time it drops to the idle interval, 5 seconds by default, so a print farm full of cameras that see nothing new costs next to nothing.
+ *  The procedures are followed through the start, step and finish callbacks of the DBusPrinter.
+ *  reportActivity() can be called from any thread, everything else only on the thread of the EventLoop that handles the DBus connection.
+ */
+class ScanRateController : public NoCopy
+{
+public:
+    /** Called when the interval of a camera changed.
+     */
+    typedef std::function<void(int id, uint64_t interval)> interval_callback_t;
+
+    ScanRateController(interval_callback_t callback);
+
+    /** Add a camera, it starts at the idle interval unless a procedure waits for a code.
+     * /param fast_interval Milliseconds between two frames when a code is expected.
+     * /returns id of the camera. Ids are numbered from 0 in the order the cameras are added, like those of the FrameFetcher.
+     */
+    int addCamera(uint64_t fast_interval);
+
+    /** Set the milliseconds between two frames of a camera in which nothing happens, 5000 by default.
+     *  0 keeps all cameras at their fast interval.
+     */
+    void setIdleInterval(uint64_t interval);
+
+    /** Set how many milliseconds a camera stays at its fast interval after the last activity, 10000 by default.
+     */
+    void setHoldTime(uint64_t time);
+
+    /** Scan all cameras fast while the procedure runs. The controller has to live as long as the DBusPrinter, its callbacks can't be removed.
+     * /param key Key of the procedure.
+     * /param steps Only scan fast during these steps of the procedure, or during all steps when it's empty.
+     */
+    void watchProcedure(const std::string& key, const std::vector<std::string>& steps = std::vector<std::string>());
+
+    /** Tell that the camera saw motion, or that the code it sees changed. Can be called from any thread.
+     */
+    void reportActivity(int id);
+
+    /** Check whether the interval of the camera should change, the callback is called if it does.
+     *  Call this for every frame, a camera only drops to the idle interval here.
+     */
+    void update(int id);
+
+    /** Get the current interval of a camera.
+     */
+    uint64_t getInterval(int id) const;
+
+private:
+    struct Camera
+    {
+        Camera(uint64_t fast_interval) : fast_interval(fast_interval), interval(0), last_activity(0) {}
+
+        const uint64_t fast_interval;
+        uint64_t interval;
+        // Time of the last activity, written by the threads that search the frames.
+        std::atomic<uint64_t> last_activity;
+    };
+
+    // Follow the step a watched procedure is in, and update all cameras when it starts or stops waiting for a code.
+    void setProcedureStep(const std::string& key, const std::string& step);
+    void setProcedureFinished(const std::string& key);
+    void updateAll();
+    uint64_t pickInterval(const Camera& camera) const;
+
+    interval_callback_t callback;
+    std::vector<std::unique_ptr<Camera>> cameras;
+    uint64_t idle_interval;
+    uint64_t hold_time;
+    // Steps of the watched procedures that wait for a code, an empty set means all of them.
+    std::map<std::string, std::set<std::string>> watched_procedures;
+    // Watched procedures that are in a step that waits for a code.
+    std::set<std::string> waiting_procedures;
+};
+
+#endif //SCAN_RATE_CONTROLLER_H
@@ -0,0 +1,149 @@
+#include "EventLoop.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <string>
+
+// Number of events handled per epoll_wait() call, more are handled by the next call.
+static const int MAX_EVENTS = 64;
+
+EventLoop::EventLoop()
+: stopping(false)
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (epoll_fd < 0 || wake_fd < 0)
+    {
+        throw std::string("Unable to initialize event loop");
+    }
+    watch(wake_fd, Readable, [this](int events)
+    {
+        uint64_t count;
+        if (read(wake_fd, &count, sizeof(count)) != sizeof(count))
+        {
+            // Someone else read the counter already, nothing to do.
+        }
+    });
+}
+
+EventLoop::~EventLoop()
+{
+    close(wake_fd);
+    close(epoll_fd);
+}
+
+void EventLoop::watch(int fd, int events, fd_callback_t callback)
+{
+    epoll_event event = {};
+    event.data.fd = fd;
+    if (events & Readable)
+    {
+        event.events |= EPOLLIN;
+    }
+    if (events & Writable)
+    {
+        event.events |= EPOLLOUT;
+    }
+    if (watches.find(fd) != watches.end())
+    {
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event);
+    } else
+    {
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+    }
+    watches[fd] = callback;
+}
+
+void EventLoop::unwatch(int fd)
+{
+    // The file descriptor may be closed already, which removed it from the epoll set as well.
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    watches.erase(fd);
+}
+
+int EventLoop::addTimer(timer_callback_t callback)
+{
+    int timer = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (timer < 0)
+    {
+        throw std::string("Unable to create timer");
+    }
+    watch(timer, Readable, [timer, callback](int events)
+    {
+        uint64_t expirations;
+        // A timer that was stopped or restarted after it expired has nothing to read anymore, and is not called.
+        if (read(timer, &expirations, sizeof(expirations)) == sizeof(expirations))
+        {
+            callback();
+        }
+    });
+    return timer;
+}
+
+void EventLoop::setTimer(int timer, long delay, long interval)
+{
+    itimerspec spec = {};
+    if (delay >= 0)
+    {
+        // A zero time stops a timerfd, so as soon as possible is 1 nanosecond.
+        spec.it_value.tv_sec = delay / 1000;
+        spec.it_value.tv_nsec = delay > 0 ? (delay % 1000) * 1000000 : 1;
+        spec.it_interval.tv_sec = interval / 1000;
+        spec.it_interval.tv_nsec = (interval % 1000) * 1000000;
+    }
+    timerfd_settime(timer, 0, &spec, nullptr);
+}
+
+void EventLoop::removeTimer(int timer)
+{
+    unwatch(timer);
+    close(timer);
+}
+
+void EventLoop::run()
+{
+    epoll_event events[MAX_EVENTS];
+    while(!stopping)
+    {
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
+        for (int i = 0; i < count && !stopping; i++)
+        {
+            // A callback may have stopped watching a file descriptor that has an event further on.
+            auto it = watches.find(events[i].data.fd);
+            if (it == watches.end())
+            {
+                continue;
+            }
+            int flags = 0;
+            if (events[i].events & EPOLLIN)
+            {
+                flags |= Readable;
+            }
+            if (events[i].events & EPOLLOUT)
+            {
+                flags |= Writable;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                flags |= Error;
+            }
+            // Called on a copy, the callback may replace or remove its own watch.
+            fd_callback_t callback = it->second;
+            callback(flags);
+        }
+    }
+    stopping = false;
+}
+
+void EventLoop::stop()
+{
+    stopping = true;
+    uint64_t wake = 1;
+    if (write(wake_fd, &wake, sizeof(wake)) != sizeof(wake))
+    {
+        // The counter can only overflow when it was written to already, the loop wakes up anyway then.
+    }
+}
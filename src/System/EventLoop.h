@@ -0,0 +1,74 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <map>
+
+#include "NoCopy.h"
+
+/**
+    The EventLoop sleeps until one of the file descriptors it watches becomes ready, or one of its timers expires, and calls the callback for it.
+    It's built on epoll, and the timers are timerfds watched like any other file descriptor, so a process that only runs an EventLoop
+    does not wake up at all until there is something to do.
+    Everything except stop() should only be called from the thread that calls run(), or while the loop is not running.
+*/
+class EventLoop : public NoCopy
+{
+public:
+    enum Events
+    {
+        Readable = 1,
+        Writable = 2,
+        // Error or hang up, always reported.
+        Error = 4,
+    };
+
+    typedef std::function<void(int events)> fd_callback_t;
+    typedef std::function<void()> timer_callback_t;
+
+    EventLoop();
+    ~EventLoop();
+
+    /** Call the callback whenever the file descriptor is ready for any of the events. Watching a file descriptor again replaces its events and callback.
+     * /param events Readable and/or Writable.
+     */
+    void watch(int fd, int events, fd_callback_t callback);
+
+    /** Stop watching a file descriptor. It's not closed.
+     */
+    void unwatch(int fd);
+
+    /** Create a timer. It does not run until setTimer() is called.
+     * /returns id of the timer.
+     */
+    int addTimer(timer_callback_t callback);
+
+    /** Start or stop a timer. A timer that was running is restarted.
+     * /param delay Milliseconds until the first call, 0 to call it as soon as possible, or less than 0 to stop the timer.
+     * /param interval Milliseconds between the calls after that, or 0 to only call it once.
+     */
+    void setTimer(int timer, long delay, long interval = 0);
+
+    /** Stop and close a timer. Timers are not removed when the loop is destroyed.
+     */
+    void removeTimer(int timer);
+
+    /** Handle events until stop() is called.
+     */
+    void run();
+
+    /** Make run() return, or the next run() when it's not running. Can be called from any thread, and from a callback.
+     */
+    void stop();
+
+private:
+    int epoll_fd;
+    // Wakes up run() to stop it.
+    int wake_fd;
+    std::atomic<bool> stopping;
+    std::map<int, fd_callback_t> watches;
+};
+
+#endif // EVENT_LOOP_H
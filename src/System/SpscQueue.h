@@ -0,0 +1,73 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <type_traits>
+#include <vector>
+
+#include "NoCopy.h"
+
+/**
+    Bounded lock-free queue between one producer thread and one consumer thread.
+    When the queue is full, push() drops the oldest item to make room, so the consumer always gets the freshest items.
+    The dropped item is handed back to the producer, so when the items are pointers to buffers, the buffer can be re-used.
+    Both threads may take the oldest item, so they race for it with a compare-exchange on the read position.
+    The slots are atomic themselves, so items have to be trivially copyable, like pointers.
+*/
+template<typename T>
+class SpscQueue : public NoCopy
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue items must be trivially copyable");
+public:
+    SpscQueue(size_t capacity)
+    : slots(capacity), head(0), tail(0)
+    {
+    }
+
+    /** Add an item at the end of the queue. Only call this from the producer thread.
+     * /param dropped Receives the oldest item when it was dropped to make room.
+     * /returns true if an item was dropped.
+     */
+    bool push(T item, T& dropped)
+    {
+        bool was_full = false;
+        size_t write = tail.load(std::memory_order_relaxed);
+        size_t read = head.load(std::memory_order_acquire);
+        if (write - read == slots.size())
+        {
+            // When the consumer took the oldest item first, the exchange fails and there is room anyway.
+            dropped = slots[read % slots.size()].load(std::memory_order_relaxed);
+            was_full = head.compare_exchange_strong(read, read + 1, std::memory_order_acq_rel);
+        }
+        slots[write % slots.size()].store(item, std::memory_order_relaxed);
+        tail.store(write + 1, std::memory_order_release);
+        return was_full;
+    }
+
+    /** Take the oldest item from the queue. Only call this from the consumer thread.
+     * /returns false if the queue is empty.
+     */
+    bool pop(T& item)
+    {
+        size_t read = head.load(std::memory_order_acquire);
+        while(read != tail.load(std::memory_order_acquire))
+        {
+            // The producer may drop this item and write a new one in its slot meanwhile, the exchange fails then and the next item is tried.
+            item = slots[read % slots.size()].load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(read, read + 1, std::memory_order_acq_rel))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::atomic<T>> slots;
+    // Positions of the next item to read and to write. They only increase, the slot is the position modulo the capacity.
+    std::atomic<size_t> head;
+    std::atomic<size_t> tail;
+};
+
+#endif // SPSC_QUEUE_H
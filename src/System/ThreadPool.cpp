@@ -0,0 +1,80 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int thread_count)
+: task(nullptr), task_count(0), next_index(0), done_count(0), stopping(false)
+{
+    if (thread_count <= 0)
+    {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i = 1; i < thread_count; i++)
+    {
+        threads.push_back(std::thread(&ThreadPool::workerMain, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_available.notify_all();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+int ThreadPool::getThreadCount() const
+{
+    return threads.size() + 1;
+}
+
+void ThreadPool::run(const std::function<void(int)>& task, int count)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    this->task = &task;
+    task_count = count;
+    next_index = 0;
+    done_count = 0;
+    work_available.notify_all();
+
+    runIterations(lock);
+    work_done.wait(lock, [this] { return done_count == task_count; });
+
+    this->task = nullptr;
+    task_count = 0;
+    next_index = 0;
+}
+
+void ThreadPool::workerMain()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true)
+    {
+        work_available.wait(lock, [this] { return stopping || next_index < task_count; });
+        if (stopping)
+        {
+            return;
+        }
+        runIterations(lock);
+    }
+}
+
+void ThreadPool::runIterations(std::unique_lock<std::mutex>& lock)
+{
+    while(next_index < task_count)
+    {
+        int index = next_index++;
+        lock.unlock();
+        (*task)(index);
+        lock.lock();
+        if (++done_count == task_count)
+        {
+            work_done.notify_all();
+        }
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "NoCopy.h"
+
+/**
+    The ThreadPool runs the iterations of a loop in parallel, on a fixed set of threads that is started once.
+    The thread that calls run() does its share of the iterations as well, so a pool for N threads starts N - 1 threads.
+    run() should only be called from one thread at a time.
+*/
+class ThreadPool : public NoCopy
+{
+public:
+    /** Start the threads.
+     * /param thread_count Number of iterations to run at the same time, including the calling thread. 0 uses one per CPU core.
+     */
+    ThreadPool(int thread_count = 0);
+    ~ThreadPool();
+
+    /** Number of iterations that run at the same time, including the calling thread.
+     */
+    int getThreadCount() const;
+
+    /** Call task(i) for each i from 0 to count - 1, and return when all calls are done.
+     *  The calls are spread over the threads in any order.
+     */
+    void run(const std::function<void(int)>& task, int count);
+
+private:
+    void workerMain();
+    // Runs iterations until none are left to start. The mutex is locked when called, and when it returns.
+    void runIterations(std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable work_done;
+    const std::function<void(int)>* task;
+    int task_count;
+    int next_index;
+    int done_count;
+    bool stopping;
+};
+
+#endif // THREAD_POOL_H
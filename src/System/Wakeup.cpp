@@ -0,0 +1,40 @@
+#include "Wakeup.h"
+
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <string>
+
+Wakeup::Wakeup()
+{
+    fd = eventfd(0, EFD_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::string("Unable to create eventfd");
+    }
+}
+
+Wakeup::~Wakeup()
+{
+    close(fd);
+}
+
+void Wakeup::notify()
+{
+    uint64_t count = 1;
+    if (write(fd, &count, sizeof(count)) != sizeof(count))
+    {
+        // Only fails when the counter would overflow, the waiting thread is woken up anyway then.
+    }
+}
+
+void Wakeup::wait()
+{
+    // Reading resets the counter, or blocks while it's 0.
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+    {
+        // Interrupted by a signal, the caller checks for work again anyway.
+    }
+}
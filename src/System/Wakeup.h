@@ -0,0 +1,28 @@
+#ifndef WAKEUP_H
+#define WAKEUP_H
+
+#include "NoCopy.h"
+
+/**
+    Lets a thread sleep until another thread has work for it, for example after pushing into a lock-free queue.
+    It's an eventfd, which counts the notifications, so a notify() that comes before the wait() is not lost.
+*/
+class Wakeup : public NoCopy
+{
+public:
+    Wakeup();
+    ~Wakeup();
+
+    /** Wake up the waiting thread, or make its next wait() return immediately.
+     */
+    void notify();
+
+    /** Sleep until notify() is called, unless it was called since the last wait() already.
+     */
+    void wait();
+
+private:
+    int fd;
+};
+
+#endif // WAKEUP_H
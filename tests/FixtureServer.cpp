@@ -0,0 +1,171 @@
+#include "FixtureServer.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+static const char BOUNDARY[] = "fixtureframe";
+
+static bool readFile(const std::string& filename, std::string& data)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool sendAll(int socket, const std::string& data)
+{
+    size_t sent = 0;
+    while(sent < data.size())
+    {
+        ssize_t result = send(socket, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0)
+        {
+            return false;
+        }
+        sent += result;
+    }
+    return true;
+}
+
+FixtureServer::FixtureServer(const std::string& directory, int stream_interval)
+: directory(directory), stream_interval(stream_interval), port(0), stopping(false)
+{
+    listen_socket = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    // Port 0 lets the kernel pick a free one.
+    address.sin_port = 0;
+    socklen_t address_size = sizeof(address);
+    if (listen_socket < 0
+        || bind(listen_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || listen(listen_socket, 128) != 0
+        || getsockname(listen_socket, reinterpret_cast<sockaddr*>(&address), &address_size) != 0)
+    {
+        throw std::string("Unable to start the fixture server");
+    }
+    port = ntohs(address.sin_port);
+    accept_thread = std::thread(&FixtureServer::acceptMain, this);
+}
+
+FixtureServer::~FixtureServer()
+{
+    stopping = true;
+    // Shutting down the sockets wakes up the threads that wait for them.
+    shutdown(listen_socket, SHUT_RDWR);
+    accept_thread.join();
+    close(listen_socket);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int socket : sockets)
+        {
+            shutdown(socket, SHUT_RDWR);
+        }
+    }
+    for (std::thread& connection : connections)
+    {
+        connection.join();
+    }
+}
+
+std::string FixtureServer::getUrl(const std::string& path) const
+{
+    return "http://127.0.0.1:" + std::to_string(port) + path;
+}
+
+void FixtureServer::acceptMain()
+{
+    while(!stopping)
+    {
+        int socket = accept(listen_socket, nullptr, nullptr);
+        if (socket < 0)
+        {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping)
+        {
+            close(socket);
+            break;
+        }
+        sockets.push_back(socket);
+        connections.push_back(std::thread(&FixtureServer::connectionMain, this, socket));
+    }
+}
+
+void FixtureServer::connectionMain(int socket)
+{
+    std::string request;
+    char buffer[4096];
+    while(!stopping)
+    {
+        // Only GET requests without a body are expected, so a request ends at the first empty line.
+        size_t end = request.find("\r\n\r\n");
+        if (end == std::string::npos)
+        {
+            ssize_t received = recv(socket, buffer, sizeof(buffer), 0);
+            if (received <= 0)
+            {
+                break;
+            }
+            request.append(buffer, received);
+            continue;
+        }
+        size_t path_start = request.find(' ') + 1;
+        std::string path = request.substr(path_start, request.find(' ', path_start) - path_start);
+        request.erase(0, end + 4);
+        if (!respond(socket, path))
+        {
+            break;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    sockets.erase(std::find(sockets.begin(), sockets.end(), socket));
+    close(socket);
+}
+
+bool FixtureServer::respond(int socket, const std::string& path)
+{
+    bool stream = path.find("?action=stream") != std::string::npos;
+    std::string name = path.substr(0, path.find('?'));
+    std::string image;
+    if (name.find("..") != std::string::npos || !readFile(directory + name, image))
+    {
+        return sendAll(socket, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+    }
+    if (!stream)
+    {
+        return sendAll(socket, "HTTP/1.1 200 OK\r\nContent-Type: image/jpeg\r\nContent-Length: " + std::to_string(image.size()) + "\r\n\r\n" + image);
+    }
+
+    // The boundary is quoted, which is allowed and has to be stripped by the client.
+    if (!sendAll(socket, std::string("HTTP/1.1 200 OK\r\nContent-Type: multipart/x-mixed-replace; boundary=\"") + BOUNDARY + "\"\r\n\r\n"))
+    {
+        return false;
+    }
+    for (int part = 0; !stopping; part++)
+    {
+        std::string headers = std::string("--") + BOUNDARY + "\r\nContent-Type: image/jpeg\r\n";
+        if (part % 2 == 0)
+        {
+            headers += "Content-Length: " + std::to_string(image.size()) + "\r\n";
+        }
+        if (!sendAll(socket, headers + "\r\n" + image + "\r\n"))
+        {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(stream_interval));
+    }
+    return false;
+}
@@ -0,0 +1,53 @@
+#ifndef FIXTURE_SERVER_H
+#define FIXTURE_SERVER_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "System/NoCopy.h"
+
+/** A small HTTP server on the loopback interface that serves the JPEG fixtures of a directory, to test the frame fetching against.
+ *  It listens on a free port, so tests can run at the same time. Every connection is handled by a thread of its own.
+ *   /<file>                  The file as a snapshot. Connections are kept open for the next request, like cameras do.
+ *   /<file>?action=stream    An mjpg-streamer like multipart stream, that repeats the file until the connection is closed.
+ *                            Only every other part has a Content-Length header, so both ways to find the end of a part are used.
+ *  Anything else gets a 404.
+ */
+class FixtureServer : public NoCopy
+{
+public:
+    /** Start serving.
+     * /param directory Directory with the fixtures.
+     * /param stream_interval Milliseconds between the parts of streams.
+     */
+    FixtureServer(const std::string& directory, int stream_interval = 20);
+    ~FixtureServer();
+
+    /** Get the URL of a path on the server.
+     * /param path Path starting with a /.
+     */
+    std::string getUrl(const std::string& path) const;
+
+private:
+    void acceptMain();
+    void connectionMain(int socket);
+    // Send a snapshot or stream, returns false if the connection should be closed.
+    bool respond(int socket, const std::string& path);
+
+    std::string directory;
+    int stream_interval;
+    int listen_socket;
+    int port;
+    std::atomic<bool> stopping;
+    std::thread accept_thread;
+
+    std::mutex mutex;
+    // Open connections, shut down to stop their threads.
+    std::vector<int> sockets;
+    std::vector<std::thread> connections;
+};
+
+#endif //FIXTURE_SERVER_H
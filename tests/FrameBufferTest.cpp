@@ -0,0 +1,98 @@
+#include <stdint.h>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "FrameBuffer.h"
+#include "MultipartParser.h"
+
+// Pass a header line to FrameBuffer::curlHeader(), and receive data after it like curl does.
+static bool checkContentLength(const char* value, size_t expected_capacity)
+{
+    FrameBuffer buffer;
+    std::string header = std::string("Content-Length: ") + value + "\r\n";
+    if (FrameBuffer::curlHeader(&header[0], 1, header.size(), &buffer) != header.size())
+    {
+        std::cout << "Content-Length " << value << ": header aborted the transfer" << std::endl;
+        return false;
+    }
+    if (buffer.getCapacity() != expected_capacity)
+    {
+        std::cout << "Content-Length " << value << ": reserved " << buffer.getCapacity() << " bytes instead of " << expected_capacity << std::endl;
+        return false;
+    }
+    std::vector<char> data(4096, 'x');
+    if (FrameBuffer::curlWrite(&data[0], 1, data.size(), &buffer) != data.size() || buffer.getSize() != data.size())
+    {
+        std::cout << "Content-Length " << value << ": data not received" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Sizes that don't fit in a size_t together with the padding or the data already in the buffer must throw instead of wrapping around.
+static bool checkOverflow()
+{
+    bool ok = true;
+    FrameBuffer buffer;
+    try
+    {
+        buffer.reserve(SIZE_MAX);
+        std::cout << "reserve(SIZE_MAX) did not throw" << std::endl;
+        ok = false;
+    } catch (const std::bad_alloc&)
+    {
+    }
+    buffer.append("x", 1);
+    try
+    {
+        buffer.append("x", SIZE_MAX);
+        std::cout << "append() past SIZE_MAX did not throw" << std::endl;
+        ok = false;
+    } catch (const std::bad_alloc&)
+    {
+    }
+    if (buffer.getSize() != 1)
+    {
+        std::cout << "Failed append() changed the buffer" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// A part with an unbelievable Content-Length is split at the boundary instead.
+static bool checkPartContentLength(const char* value)
+{
+    std::vector<std::string> parts;
+    MultipartParser parser([&parts](FrameBuffer& part)
+    {
+        parts.push_back(std::string(reinterpret_cast<const char*>(part.getData()), part.getSize()));
+    });
+    parser.setBoundary("frame");
+    std::string stream = std::string("--frame\r\nContent-Length: ") + value + "\r\n\r\nimage\r\n--frame\r\n\r\n";
+    parser.feed(stream.data(), stream.size());
+    if (parts.size() != 1 || parts[0] != "image")
+    {
+        std::cout << "Part with Content-Length " << value << " was not split at the boundary" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    bool ok = true;
+    ok = checkContentLength("1000", 1000) && ok;
+    ok = checkContentLength("16777217", 0) && ok;
+    ok = checkContentLength("18446744073709551615", 0) && ok;
+    ok = checkContentLength("99999999999999999999999", 0) && ok;
+    ok = checkOverflow() && ok;
+    ok = checkPartContentLength("16777217") && ok;
+    ok = checkPartContentLength("18446744073709551615") && ok;
+    if (ok)
+    {
+        std::cout << "Oversized and overflowing sizes are rejected" << std::endl;
+    }
+    return ok ? 0 : 1;
+}
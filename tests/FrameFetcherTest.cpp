@@ -0,0 +1,135 @@
+#include <curl/curl.h>
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "FixtureServer.h"
+#include "FrameFetcher.h"
+#include "System/EventLoop.h"
+
+static const char* const IMAGES[] = {"h1v1.jpg", "h2v1.jpg", "h1v2.jpg", "h2v2.jpg", "h2v2_wide.jpg", "h2v2_progressive.jpg"};
+static const int IMAGE_COUNT = sizeof(IMAGES) / sizeof(IMAGES[0]);
+// Enough snapshot cameras to keep many transfers in flight on the single thread of the loop.
+static const int SNAPSHOT_CAMERAS = 60;
+static const int STREAM_CAMERAS = 4;
+static const uint64_t SNAPSHOT_INTERVAL_MS = 50;
+// Frames every camera has to deliver before the test passes.
+static const int FRAMES_PER_CAMERA = 5;
+static const long TIMEOUT_MS = 20000;
+
+struct TestCamera
+{
+    std::string expected;
+    bool missing;
+    int frames;
+    int wrong_frames;
+    int errors;
+};
+
+static bool readFile(const std::string& filename, std::string& data)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+static bool isDone(const std::vector<TestCamera>& cameras)
+{
+    for (const TestCamera& camera : cameras)
+    {
+        if (camera.missing ? camera.errors == 0 : camera.frames < FRAMES_PER_CAMERA)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Usage: frame-fetcher-test <directory with the test images>
+ *  Fetches snapshots and streams of the test images from a FixtureServer, and checks that every frame arrives intact.
+ */
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <directory with the test images>" << std::endl;
+        return 1;
+    }
+    std::string images[IMAGE_COUNT];
+    for (int i = 0; i < IMAGE_COUNT; i++)
+    {
+        if (!readFile(std::string(argv[1]) + "/" + IMAGES[i], images[i]))
+        {
+            std::cout << "Unable to read " << IMAGES[i] << std::endl;
+            return 1;
+        }
+    }
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    FixtureServer server(argv[1]);
+    EventLoop loop;
+    std::vector<TestCamera> cameras;
+    FrameFetcher fetcher(loop, [&](int id, FrameBuffer& frame)
+    {
+        TestCamera& camera = cameras[id];
+        camera.frames++;
+        if (std::string(reinterpret_cast<const char*>(frame.getData()), frame.getSize()) != camera.expected)
+        {
+            camera.wrong_frames++;
+        }
+        if (isDone(cameras))
+        {
+            loop.stop();
+        }
+    }, [&](int id, const char* error)
+    {
+        TestCamera& camera = cameras[id];
+        if (!camera.missing)
+        {
+            std::cout << "Camera " << id << ": " << error << std::endl;
+        }
+        camera.errors++;
+    });
+
+    for (int i = 0; i < SNAPSHOT_CAMERAS + STREAM_CAMERAS; i++)
+    {
+        bool stream = i >= SNAPSHOT_CAMERAS;
+        std::string path = std::string("/") + IMAGES[i % IMAGE_COUNT] + (stream ? "?action=stream" : "");
+        fetcher.addCamera(server.getUrl(path), stream ? 0 : SNAPSHOT_INTERVAL_MS);
+        cameras.push_back(TestCamera{images[i % IMAGE_COUNT], false, 0, 0, 0});
+    }
+    fetcher.addCamera(server.getUrl("/missing.jpg"), SNAPSHOT_INTERVAL_MS);
+    cameras.push_back(TestCamera{"", true, 0, 0, 0});
+
+    int timeout_timer = loop.addTimer([&]() { loop.stop(); });
+    loop.setTimer(timeout_timer, TIMEOUT_MS);
+    fetcher.start();
+    loop.run();
+    fetcher.stop();
+    loop.removeTimer(timeout_timer);
+
+    bool ok = isDone(cameras);
+    if (!ok)
+    {
+        std::cout << "Not every camera delivered " << FRAMES_PER_CAMERA << " frames within " << TIMEOUT_MS << " ms" << std::endl;
+    }
+    for (unsigned int id = 0; id < cameras.size(); id++)
+    {
+        const TestCamera& camera = cameras[id];
+        if (camera.wrong_frames > 0 || (camera.missing && camera.frames > 0))
+        {
+            std::cout << "Camera " << id << ": " << camera.wrong_frames << " of " << camera.frames << " frames differ from the image" << std::endl;
+            ok = false;
+        }
+    }
+    std::cout << SNAPSHOT_CAMERAS << " snapshot and " << STREAM_CAMERAS << " stream cameras: " << (ok ? "all frames match" : "failed") << std::endl;
+    curl_global_cleanup();
+    return ok ? 0 : 1;
+}
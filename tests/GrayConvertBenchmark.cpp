@@ -0,0 +1,71 @@
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+#include "Image/GrayConvert.h"
+#include "Image/jpgd_simd.h"
+#include "System/Clock.h"
+
+// A 1920x1080 frame, converted a row at a time like ImageReaderSource does.
+static const int WIDTH = 1920;
+static const int HEIGHT = 1080;
+static const int ROUNDS = 20;
+
+// Time the conversion of a frame, and report it in milliseconds per frame.
+static void benchmark(const char* name, GrayConvertFunction function, int comps)
+{
+    std::vector<uint8_t> pixels(WIDTH * HEIGHT * comps);
+    for (unsigned int i = 0; i < pixels.size(); i++)
+    {
+        pixels[i] = rand() & 0xFF;
+    }
+    std::vector<uint8_t> gray(WIDTH * HEIGHT);
+
+    Clock clock;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (int y = 0; y < HEIGHT; y++)
+        {
+            function(&pixels[y * WIDTH * comps], &gray[y * WIDTH], WIDTH);
+        }
+    }
+    std::cout << name << ": " << (clock.getMilliseconds() / double(ROUNDS)) << " ms per 1920x1080 frame" << std::endl;
+}
+
+static void convertRGB(const uint8_t* pixels, uint8_t* gray, int count)
+{
+    convertRGBToGray(pixels, gray, count, 3);
+}
+
+static void convertRGBA(const uint8_t* pixels, uint8_t* gray, int count)
+{
+    convertRGBToGray(pixels, gray, count, 4);
+}
+
+int main()
+{
+    srand(1);
+    benchmark("RGB scalar", convertRGB, 3);
+    benchmark("RGBA scalar", convertRGBA, 4);
+    jpgd::simd_support support = jpgd::get_simd_support();
+#if defined(JPGD_SIMD_X86)
+    if (support == jpgd::SIMD_SSE2 || support == jpgd::SIMD_AVX2)
+    {
+        benchmark("RGB SSE2", convertRGBToGraySSE2, 3);
+        benchmark("RGBA SSE2", convertRGBAToGraySSE2, 4);
+    }
+    if (support == jpgd::SIMD_AVX2)
+    {
+        benchmark("RGB AVX2", convertRGBToGrayAVX2, 3);
+        benchmark("RGBA AVX2", convertRGBAToGrayAVX2, 4);
+    }
+#endif
+#if defined(JPGD_SIMD_NEON)
+    if (support == jpgd::SIMD_NEON)
+    {
+        benchmark("RGB NEON", convertRGBToGrayNEON, 3);
+        benchmark("RGBA NEON", convertRGBAToGrayNEON, 4);
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+
+#include "Image/GrayConvert.h"
+#include "Image/jpgd_simd.h"
+
+// Pixel counts up to this are all tried, so every kernel runs with every number of pixels left for its scalar tail.
+static const int MAX_COUNT = 64;
+// Bytes after the output that must not be written.
+static const int GUARD = 16;
+
+// Compare a SIMD conversion with convertRGBToGray() for all pixel counts, on random pixels and on all black and all white ones.
+static bool checkConversion(const char* name, GrayConvertFunction function, int comps)
+{
+    for (int pattern = 0; pattern < 3; pattern++)
+    {
+        for (int count = 0; count <= MAX_COUNT; count++)
+        {
+            std::vector<uint8_t> pixels(count * comps + 1);
+            for (unsigned int i = 0; i < pixels.size(); i++)
+            {
+                pixels[i] = pattern == 0 ? rand() & 0xFF : pattern == 1 ? 0 : 255;
+            }
+            std::vector<uint8_t> expected(count + GUARD, 0xA5);
+            std::vector<uint8_t> result(count + GUARD, 0xA5);
+            convertRGBToGray(&pixels[0], &expected[0], count, comps);
+            function(&pixels[0], &result[0], count);
+            if (expected != result)
+            {
+                std::cout << name << ": differs from convertRGBToGray() for " << count << " pixels" << std::endl;
+                return false;
+            }
+        }
+    }
+    std::cout << name << ": matches for 0 to " << MAX_COUNT << " pixels" << std::endl;
+    return true;
+}
+
+int main()
+{
+    srand(1);
+    bool ok = true;
+    jpgd::simd_support support = jpgd::get_simd_support();
+#if defined(JPGD_SIMD_X86)
+    if (support == jpgd::SIMD_SSE2 || support == jpgd::SIMD_AVX2)
+    {
+        ok = checkConversion("convertRGBToGraySSE2", convertRGBToGraySSE2, 3) && ok;
+        ok = checkConversion("convertRGBAToGraySSE2", convertRGBAToGraySSE2, 4) && ok;
+    }
+    if (support == jpgd::SIMD_AVX2)
+    {
+        ok = checkConversion("convertRGBToGrayAVX2", convertRGBToGrayAVX2, 3) && ok;
+        ok = checkConversion("convertRGBAToGrayAVX2", convertRGBAToGrayAVX2, 4) && ok;
+    }
+#endif
+#if defined(JPGD_SIMD_NEON)
+    if (support == jpgd::SIMD_NEON)
+    {
+        ok = checkConversion("convertRGBToGrayNEON", convertRGBToGrayNEON, 3) && ok;
+        ok = checkConversion("convertRGBAToGrayNEON", convertRGBAToGrayNEON, 4) && ok;
+    }
+#endif
+    // The conversions handed out to ImageReaderSource.
+    ok = checkConversion("getGrayConvertFunction(3)", getGrayConvertFunction(3), 3) && ok;
+    ok = checkConversion("getGrayConvertFunction(4)", getGrayConvertFunction(4), 4) && ok;
+    return ok ? 0 : 1;
+}
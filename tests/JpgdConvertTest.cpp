@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+#include "Image/jpgd_simd.h"
+
+using namespace jpgd;
+
+// Small images with odd sizes, so the last MCU of every row and column is partly outside the image.
+// Each sampling uses another converter: H1V1Convert(), H2V1Convert(), H1V2Convert(), and expanded_convert() for H2V2,
+// or H2V2Convert() when jpgd is built with JPGD_SUPPORT_FREQ_DOMAIN_UPSAMPLING set to 0.
+static const char* const IMAGES[] = {"h1v1.jpg", "h2v1.jpg", "h1v2.jpg", "h2v2.jpg", "h2v2_wide.jpg", "h2v2_progressive.jpg"};
+
+// Decode an image to RGBA with the SIMD colour conversion enabled or disabled.
+static unsigned char* decode(const std::string& filename, bool simd, int& width, int& height)
+{
+    set_simd_enabled(simd);
+    int comps;
+    return decompress_jpeg_image_from_file(filename.c_str(), &width, &height, &comps, 4);
+}
+
+// Compare the RGBA output of the SIMD and the scalar conversion of an image.
+static bool checkImage(const std::string& filename)
+{
+    int scalar_width, scalar_height, simd_width, simd_height;
+    unsigned char* scalar = decode(filename, false, scalar_width, scalar_height);
+    unsigned char* simd = decode(filename, true, simd_width, simd_height);
+    bool ok = true;
+    if (!scalar || !simd)
+    {
+        std::cout << filename << ": unable to decode" << std::endl;
+        ok = false;
+    } else if (scalar_width != simd_width || scalar_height != simd_height)
+    {
+        std::cout << filename << ": sizes differ" << std::endl;
+        ok = false;
+    } else
+    {
+        for (int y = 0; y < scalar_height && ok; y++)
+        {
+            for (int x = 0; x < scalar_width * 4 && ok; x++)
+            {
+                int offset = y * scalar_width * 4 + x;
+                if (scalar[offset] != simd[offset])
+                {
+                    std::cout << filename << ": pixel " << (x / 4) << "," << y << " differs from the scalar conversion" << std::endl;
+                    ok = false;
+                }
+            }
+        }
+    }
+    if (ok)
+    {
+        std::cout << filename << ": " << scalar_width << "x" << scalar_height << " matches" << std::endl;
+    }
+    free(scalar);
+    free(simd);
+    return ok;
+}
+
+/** Usage: jpgd-convert-test <directory with the test images>
+ */
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <directory with the test images>" << std::endl;
+        return 1;
+    }
+    if (get_simd_support() == SIMD_NONE)
+    {
+        std::cout << "No SIMD colour conversion for this CPU, only checking that the images decode" << std::endl;
+    }
+    bool ok = true;
+    for (const char* image : IMAGES)
+    {
+        ok = checkImage(std::string(argv[1]) + "/" + image) && ok;
+    }
+    set_simd_enabled(true);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <iostream>
+#include <vector>
+
+#include "Image/jpgd_simd.h"
+#include "System/Clock.h"
+
+using namespace jpgd;
+
+static const int BLOCK_COUNT = 4096;
+static const int ROUNDS = 200;
+
+static std::vector<jpgd_block_t> coefficients;
+static std::vector<uint8> pixels(BLOCK_COUNT * 64);
+
+// Time the IDCT of all blocks, and report it in nanoseconds per block.
+template<typename Function>
+static void benchmark(const char* name, Function function)
+{
+    Clock clock;
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        for (int n = 0; n < BLOCK_COUNT; n++)
+        {
+            function(&coefficients[n * 64], &pixels[n * 64]);
+        }
+    }
+    uint64_t time = clock.getMilliseconds();
+    std::cout << name << ": " << (time * 1000000.0 / (ROUNDS * BLOCK_COUNT)) << " ns per block" << std::endl;
+}
+
+int main()
+{
+    // Mostly small coefficients, like the dequantized blocks of a camera frame.
+    srand(1);
+    coefficients.resize(BLOCK_COUNT * 64);
+    for (unsigned int i = 0; i < coefficients.size(); i++)
+    {
+        coefficients[i] = (i % 64) < 16 ? rand() % 512 - 256 : rand() % 16 - 8;
+    }
+
+    set_simd_enabled(false);
+    benchmark("scalar", [](const jpgd_block_t* src, uint8* dst) { idct(src, dst, 64); });
+    simd_support support = get_simd_support();
+#if defined(JPGD_SIMD_X86)
+    if (support == SIMD_SSE2 || support == SIMD_AVX2)
+    {
+        benchmark("sse2", idct_sse2);
+    }
+    if (support == SIMD_AVX2)
+    {
+        benchmark("avx2", idct_avx2);
+    }
+#endif
+#if defined(JPGD_SIMD_NEON)
+    if (support == SIMD_NEON)
+    {
+        benchmark("neon", idct_neon);
+    }
+#endif
+    set_simd_enabled(true);
+    return 0;
+}
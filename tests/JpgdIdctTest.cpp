@@ -0,0 +1,105 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+
+#include "Image/jpgd_simd.h"
+
+using namespace jpgd;
+
+typedef std::vector<jpgd_block_t> Block;
+
+// Fill blocks with coefficients in the given range, like the dequantized blocks of real images and beyond.
+static void addRandomBlocks(std::vector<Block>& blocks, int count, int range)
+{
+    for (int n = 0; n < count; n++)
+    {
+        Block block(64);
+        for (int i = 0; i < 64; i++)
+        {
+            block[i] = rand() % (2 * range + 1) - range;
+        }
+        blocks.push_back(block);
+    }
+}
+
+// Blocks at the limits of the coefficients, which clamp every pixel.
+static void addExtremeBlocks(std::vector<Block>& blocks)
+{
+    static const int values[] = {32767, -32768, 2047, -2048, 1, -1};
+    for (int value : values)
+    {
+        blocks.push_back(Block(64, value));
+        Block alternating(64);
+        Block dc_only(64, 0);
+        Block ac_only(64, 0);
+        for (int i = 0; i < 64; i++)
+        {
+            alternating[i] = (i & 1) ? value : -value;
+        }
+        dc_only[0] = value;
+        ac_only[63] = value;
+        blocks.push_back(alternating);
+        blocks.push_back(dc_only);
+        blocks.push_back(ac_only);
+    }
+}
+
+// Compare a SIMD kernel with the scalar IDCT on all blocks.
+static bool checkKernel(const char* name, simd_idct_func kernel, const std::vector<Block>& blocks)
+{
+    int failures = 0;
+    for (unsigned int n = 0; n < blocks.size(); n++)
+    {
+        uint8 expected[64];
+        uint8 result[64];
+        idct(&blocks[n][0], expected, 64);
+        kernel(&blocks[n][0], result);
+        if (memcmp(expected, result, sizeof(result)) != 0)
+        {
+            if (failures++ < 5)
+            {
+                std::cout << name << ": block " << n << " differs from the scalar IDCT" << std::endl;
+            }
+        }
+    }
+    std::cout << name << ": " << (blocks.size() - failures) << " of " << blocks.size() << " blocks match" << std::endl;
+    return failures == 0;
+}
+
+int main()
+{
+    srand(1);
+    std::vector<Block> blocks;
+    addExtremeBlocks(blocks);
+    addRandomBlocks(blocks, 10000, 64);
+    addRandomBlocks(blocks, 10000, 1024);
+    addRandomBlocks(blocks, 10000, 32767);
+
+    // idct() is the scalar reference while SIMD is disabled.
+    set_simd_enabled(false);
+    bool ok = true;
+    simd_support support = get_simd_support();
+#if defined(JPGD_SIMD_X86)
+    if (support == SIMD_SSE2 || support == SIMD_AVX2)
+    {
+        ok = checkKernel("idct_sse2", idct_sse2, blocks) && ok;
+    }
+    if (support == SIMD_AVX2)
+    {
+        ok = checkKernel("idct_avx2", idct_avx2, blocks) && ok;
+    }
+#endif
+#if defined(JPGD_SIMD_NEON)
+    if (support == SIMD_NEON)
+    {
+        ok = checkKernel("idct_neon", idct_neon, blocks) && ok;
+    }
+#endif
+    if (support == SIMD_NONE)
+    {
+        std::cout << "No SIMD IDCT for this CPU, nothing to compare" << std::endl;
+    }
+    set_simd_enabled(true);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,200 @@
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Image/jpgd.h"
+#include "System/ThreadPool.h"
+
+using namespace jpgd;
+
+// Images with restart intervals that don't divide the MCU rows, so intervals start and end in the middle of rows:
+// 203x45 H1V1 with 26 MCUs per row and an interval of 7 MCUs, and 203x45 H2V2 with 13 MCUs per row and an interval of 5 MCUs.
+static const char* const IMAGES[] = {"h1v1_restart.jpg", "h2v2_restart.jpg"};
+static const int THREAD_COUNTS[] = {1, 2, 3, 8};
+
+// Runs the restart intervals on a ThreadPool, like QRDetector does.
+class ThreadPoolExecutor : public jpeg_decoder_executor
+{
+public:
+    ThreadPoolExecutor(int thread_count) : pool(thread_count) {}
+
+    virtual int get_num_threads()
+    {
+        return pool.getThreadCount();
+    }
+
+    virtual void run(void (*task)(void* data, int index), void* data, int count)
+    {
+        pool.run([task, data](int index) { task(data, index); }, count);
+    }
+private:
+    ThreadPool pool;
+};
+
+// How an image is decoded.
+struct Settings
+{
+    const char* name;
+    uint flags;
+    // Crop rectangle, not set when the width is 0.
+    int crop_x, crop_y, crop_width, crop_height;
+};
+
+static const Settings SETTINGS[] = {
+    {"RGBA", 0, 0, 0, 0, 0},
+    {"luma", JPGD_FLAG_LUMA_ONLY, 0, 0, 0, 0},
+    {"cropped RGBA", 0, 13, 9, 101, 27},
+    {"1/2 scale", JPGD_FLAG_SCALE_1_2, 0, 0, 0, 0},
+    {"cropped 1/8 scale", JPGD_FLAG_SCALE_1_8, 40, 17, 150, 20},
+};
+
+struct Result
+{
+    // Status of begin_decoding(), or of the first decode() that failed.
+    int status;
+    bool parallel;
+    std::vector<uint8> pixels;
+};
+
+// Decode a JPEG image in place, on the executor when one is given.
+static Result decode(const std::string& image, const Settings& settings, jpeg_decoder_executor* executor)
+{
+    Result result;
+    result.parallel = false;
+    std::vector<uint8> data(image.begin(), image.end());
+    data.resize(image.size() + JPGD_IN_PLACE_PAD_SIZE);
+    jpeg_decoder_mem_stream stream;
+    stream.open_in_place(&data[0], image.size());
+    jpeg_decoder decoder(&stream, settings.flags);
+    decoder.set_executor(executor);
+    if (settings.crop_width > 0)
+    {
+        decoder.set_crop_rect(settings.crop_x, settings.crop_y, settings.crop_width, settings.crop_height);
+    }
+    result.status = decoder.get_error_code() == JPGD_SUCCESS ? decoder.begin_decoding() : JPGD_FAILED;
+    if (result.status != JPGD_SUCCESS)
+    {
+        return result;
+    }
+    result.parallel = decoder.is_parallel();
+    for (int y = 0; y < decoder.get_height(); y++)
+    {
+        const void* line;
+        uint line_size;
+        result.status = decoder.decode(&line, &line_size);
+        if (result.status != JPGD_SUCCESS)
+        {
+            return result;
+        }
+        result.pixels.insert(result.pixels.end(), static_cast<const uint8*>(line), static_cast<const uint8*>(line) + line_size);
+    }
+    return result;
+}
+
+// Decode with every number of threads, and compare with the sequential decode.
+// /param expect_parallel Whether the restart intervals must be decoded in parallel. When not, a failure to decode is also accepted.
+static bool checkImage(const std::string& name, const std::string& image, bool expect_parallel)
+{
+    bool ok = true;
+    for (const Settings& settings : SETTINGS)
+    {
+        Result sequential = decode(image, settings, nullptr);
+        if (expect_parallel && sequential.status != JPGD_SUCCESS)
+        {
+            std::cout << name << ", " << settings.name << ": sequential decode failed" << std::endl;
+            ok = false;
+            continue;
+        }
+        for (int thread_count : THREAD_COUNTS)
+        {
+            ThreadPoolExecutor executor(thread_count);
+            Result parallel = decode(image, settings, &executor);
+            if (expect_parallel && !parallel.parallel)
+            {
+                std::cout << name << ", " << settings.name << ", " << thread_count << " threads: not decoded in parallel" << std::endl;
+                ok = false;
+            } else if (parallel.status != sequential.status && !(parallel.status == JPGD_FAILED && !expect_parallel))
+            {
+                std::cout << name << ", " << settings.name << ", " << thread_count << " threads: status " << parallel.status << " instead of " << sequential.status << std::endl;
+                ok = false;
+            } else if (parallel.status == JPGD_SUCCESS && parallel.pixels != sequential.pixels)
+            {
+                std::cout << name << ", " << settings.name << ", " << thread_count << " threads: differs from the sequential decode" << std::endl;
+                ok = false;
+            }
+        }
+    }
+    if (ok)
+    {
+        std::cout << name << ": matches the sequential decode" << std::endl;
+    }
+    return ok;
+}
+
+// Offset of the n-th restart marker in the image, or 0 when it has less.
+static size_t findRestartMarker(const std::string& image, int n)
+{
+    size_t scan = image.find("\xFF\xDA");
+    for (size_t i = scan; scan != std::string::npos && i + 1 < image.size(); i++)
+    {
+        unsigned char marker = image[i + 1];
+        if (static_cast<unsigned char>(image[i]) == 0xFF && marker >= 0xD0 && marker <= 0xD7 && n-- == 0)
+        {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// Damaged images, which the pre-scan of the restart markers must leave to the sequential decoder, or which must fail cleanly.
+static bool checkDamagedImages(const std::string& name, const std::string& image)
+{
+    bool ok = true;
+    size_t marker = findRestartMarker(image, 2);
+
+    // The restart markers are not in order.
+    std::string wrong_marker = image;
+    wrong_marker[marker + 1] = static_cast<char>(0xD7);
+    ok = checkImage(name + " with a wrong restart marker", wrong_marker, false) && ok;
+
+    // The image ends before its last restart marker and EOI.
+    ok = checkImage(name + " truncated", image.substr(0, marker + 20), false) && ok;
+
+    // The entropy coded data of an interval is garbage, the markers are fine.
+    std::string corrupt = image;
+    for (size_t i = marker + 2; i < marker + 40; i++)
+    {
+        corrupt[i] = static_cast<char>(i * 37 % 255);
+    }
+    ok = checkImage(name + " with a corrupt interval", corrupt, false) && ok;
+    return ok;
+}
+
+/** Usage: jpgd-parallel-test <directory with the test images>
+ */
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <directory with the test images>" << std::endl;
+        return 1;
+    }
+    bool ok = true;
+    for (const char* name : IMAGES)
+    {
+        std::ifstream file(std::string(argv[1]) + "/" + name, std::ios::binary);
+        std::string image((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (image.empty() || findRestartMarker(image, 2) == 0)
+        {
+            std::cout << name << ": unable to read, or no restart markers" << std::endl;
+            ok = false;
+            continue;
+        }
+        ok = checkImage(name, image, true) && ok;
+        ok = checkDamagedImages(name, image) && ok;
+    }
+    return ok ? 0 : 1;
+}
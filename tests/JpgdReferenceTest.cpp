@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "Image/jpgd_simd.h"
+
+using namespace jpgd;
+
+// Each image has a <name>.rgba next to it with its RGBA pixels, as decoded by jpgd before the Huffman decoding read the bits 64 at a time.
+// h2v2_progressive.jpg is progressive, h2v2_noise.jpg is random noise at quality 100, so its entropy coded data is full of stuffed 0xFF bytes,
+// and the restart images have restart intervals that end in the middle of the MCU rows.
+static const char* const IMAGES[] = {"h2v2_progressive.jpg", "h2v2_noise.jpg", "h1v1_restart.jpg", "h2v2_restart.jpg"};
+// The decoder refills its bit buffer 8 bytes at a time when they are in its input buffer, and a byte at a time near its end.
+// Small reads put the end of the input buffer at every place in the data, 0 reads the whole image in place.
+static const int READ_SIZES[] = {0, 1, 3, 7, 64, 4096};
+
+// Returns the image in reads of at most read_size bytes.
+class ChunkedStream : public jpeg_decoder_stream
+{
+public:
+    ChunkedStream(const std::string& image, int read_size) : image(image), read_size(read_size), offset(0) {}
+
+    virtual int read(uint8* pBuf, int max_bytes_to_read, bool* pEOF_flag)
+    {
+        int size = std::min(std::min(max_bytes_to_read, read_size), static_cast<int>(image.size() - offset));
+        std::copy(image.begin() + offset, image.begin() + offset + size, pBuf);
+        offset += size;
+        *pEOF_flag = offset == image.size();
+        return size;
+    }
+private:
+    const std::string& image;
+    int read_size;
+    size_t offset;
+};
+
+static bool readFile(const std::string& filename, std::string& data)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Decode the image to RGBA pixels, from the stream.
+static bool decode(jpeg_decoder_stream& stream, std::vector<uint8>& pixels)
+{
+    jpeg_decoder decoder(&stream);
+    if (decoder.get_error_code() != JPGD_SUCCESS || decoder.begin_decoding() != JPGD_SUCCESS || decoder.get_bytes_per_pixel() != 4)
+    {
+        return false;
+    }
+    pixels.clear();
+    for (int y = 0; y < decoder.get_height(); y++)
+    {
+        const void* line;
+        uint line_size;
+        if (decoder.decode(&line, &line_size) != JPGD_SUCCESS)
+        {
+            return false;
+        }
+        pixels.insert(pixels.end(), static_cast<const uint8*>(line), static_cast<const uint8*>(line) + decoder.get_width() * 4);
+    }
+    return true;
+}
+
+// Decode the image with and without SIMD, for every read size, and compare with the reference pixels.
+static bool checkImage(const std::string& name, const std::string& image, const std::string& reference)
+{
+    bool ok = true;
+    for (bool simd : {false, true})
+    {
+        set_simd_enabled(simd);
+        for (int read_size : READ_SIZES)
+        {
+            std::vector<uint8> pixels;
+            bool decoded;
+            if (read_size == 0)
+            {
+                std::vector<uint8> data(image.begin(), image.end());
+                data.resize(image.size() + JPGD_IN_PLACE_PAD_SIZE);
+                jpeg_decoder_mem_stream stream;
+                stream.open_in_place(&data[0], image.size());
+                decoded = decode(stream, pixels);
+            } else
+            {
+                ChunkedStream stream(image, read_size);
+                decoded = decode(stream, pixels);
+            }
+
+            std::string description = name + (simd ? ", SIMD, " : ", scalar, ") + (read_size == 0 ? std::string("in place") : "reads of " + std::to_string(read_size) + " bytes");
+            if (!decoded)
+            {
+                std::cout << description << ": decode failed" << std::endl;
+                ok = false;
+            } else if (pixels.size() != reference.size())
+            {
+                std::cout << description << ": " << pixels.size() << " bytes of pixels instead of " << reference.size() << std::endl;
+                ok = false;
+            } else
+            {
+                std::pair<std::vector<uint8>::iterator, std::string::const_iterator> difference = std::mismatch(pixels.begin(), pixels.end(), reference.begin(),
+                    [](uint8 pixel, char expected) { return pixel == static_cast<uint8>(expected); });
+                if (difference.first != pixels.end())
+                {
+                    std::cout << description << ": differs from the reference at byte " << (difference.first - pixels.begin()) << std::endl;
+                    ok = false;
+                }
+            }
+        }
+    }
+    set_simd_enabled(true);
+    return ok;
+}
+
+// Markers may be preceded by any number of 0xFF fill bytes. Add some before every restart marker and the EOI.
+static std::string addFillBytes(const std::string& image)
+{
+    std::string filled;
+    size_t scan = image.find("\xFF\xDA");
+    for (size_t i = 0; i < image.size(); i++)
+    {
+        unsigned char marker = i + 1 < image.size() ? image[i + 1] : 0;
+        if (i > scan && static_cast<unsigned char>(image[i]) == 0xFF && ((marker >= 0xD0 && marker <= 0xD7) || marker == 0xD9))
+        {
+            filled.append(marker % 3 + 1, static_cast<char>(0xFF));
+        }
+        filled += image[i];
+    }
+    return filled;
+}
+
+/** Usage: jpgd-reference-test <directory with the test images>
+ */
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <directory with the test images>" << std::endl;
+        return 1;
+    }
+    std::string directory = argv[1];
+    bool ok = true;
+    for (const char* name : IMAGES)
+    {
+        std::string image;
+        std::string reference;
+        std::string reference_name = std::string(name).substr(0, std::string(name).rfind('.')) + ".rgba";
+        if (!readFile(directory + "/" + name, image) || !readFile(directory + "/" + reference_name, reference))
+        {
+            std::cout << "Unable to read " << name << " or " << reference_name << std::endl;
+            ok = false;
+            continue;
+        }
+        bool image_ok = checkImage(name, image, reference);
+        if (image.find("\xFF\xD0") != std::string::npos)
+        {
+            image_ok = checkImage(std::string(name) + " with fill bytes", addFillBytes(image), reference) && image_ok;
+        }
+        if (image_ok)
+        {
+            std::cout << name << ": matches the reference" << std::endl;
+        }
+        ok = image_ok && ok;
+    }
+    return ok ? 0 : 1;
+}
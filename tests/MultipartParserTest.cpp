@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "MultipartParser.h"
+
+// stream.mjpeg is an mjpg-streamer "?action=stream" response, with the HTTP headers. The boundary in its Content-Type header is quoted.
+// The parts are these images. Only the first, third and last part have a Content-Length header, the others end at the next boundary.
+// The recording stops in the middle of the headers of one more part, which must not be reported.
+static const char* const PARTS[] = {"h1v1.jpg", "h2v1.jpg", "h1v2.jpg", "h2v2.jpg", "h1v1.jpg"};
+static const char BOUNDARY[] = "boundarydonotcross";
+
+static bool readFile(const std::string& filename, std::string& data)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Feed the body to a parser in chunks of the given size, which splits the boundaries and headers at every possible place for some chunk size.
+static bool checkChunks(const std::string& boundary, const std::string& body, size_t chunk_size, const std::vector<std::string>& expected)
+{
+    std::vector<std::string> parts;
+    MultipartParser parser([&parts](FrameBuffer& part)
+    {
+        parts.push_back(std::string(reinterpret_cast<const char*>(part.getData()), part.getSize()));
+    });
+    parser.setBoundary(boundary);
+    for (size_t offset = 0; offset < body.size(); offset += chunk_size)
+    {
+        parser.feed(body.data() + offset, std::min(chunk_size, body.size() - offset));
+    }
+
+    if (parts.size() != expected.size())
+    {
+        std::cout << "Chunks of " << chunk_size << " bytes: " << parts.size() << " parts instead of " << expected.size() << std::endl;
+        return false;
+    }
+    for (unsigned int n = 0; n < parts.size(); n++)
+    {
+        if (parts[n] != expected[n])
+        {
+            std::cout << "Chunks of " << chunk_size << " bytes: part " << n << " differs from " << PARTS[n] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Usage: multipart-parser-test <directory with the test images>
+ */
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        std::cout << "Usage: " << argv[0] << " <directory with the test images>" << std::endl;
+        return 1;
+    }
+    std::string directory = argv[1];
+    std::string recording;
+    if (!readFile(directory + "/stream.mjpeg", recording))
+    {
+        std::cout << "Unable to read stream.mjpeg" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> expected;
+    for (const char* name : PARTS)
+    {
+        std::string image;
+        if (!readFile(directory + "/" + name, image))
+        {
+            std::cout << "Unable to read " << name << std::endl;
+            return 1;
+        }
+        expected.push_back(image);
+    }
+
+    // The boundary comes from the HTTP headers, like curl hands them to FrameFetcher::curlStreamHeader() a line at a time.
+    size_t headers_end = recording.find("\r\n\r\n");
+    std::istringstream header_lines(recording.substr(0, headers_end + 2));
+    std::string boundary;
+    std::string line;
+    while(std::getline(header_lines, line))
+    {
+        std::string line_boundary = MultipartParser::parseBoundary(line + "\n");
+        if (!line_boundary.empty())
+        {
+            boundary = line_boundary;
+        }
+    }
+    if (boundary != BOUNDARY)
+    {
+        std::cout << "Boundary parsed as \"" << boundary << "\" instead of \"" << BOUNDARY << "\"" << std::endl;
+        return 1;
+    }
+
+    std::string body = recording.substr(headers_end + 4);
+    bool ok = true;
+    for (size_t chunk_size = 1; chunk_size <= 64; chunk_size++)
+    {
+        ok = checkChunks(boundary, body, chunk_size, expected) && ok;
+    }
+    for (size_t chunk_size : {1000, 1460, 4096, 16384})
+    {
+        ok = checkChunks(boundary, body, chunk_size, expected) && ok;
+    }
+    ok = checkChunks(boundary, body, body.size(), expected) && ok;
+    if (ok)
+    {
+        std::cout << "All " << expected.size() << " parts match for every chunk size" << std::endl;
+    }
+    return ok ? 0 : 1;
+}